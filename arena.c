@@ -0,0 +1,127 @@
+#include "arena.h"
+
+#ifdef POSTGRESQL
+# include "utils/memutils.h"
+
+Arena *arena_new(size_t UNUSED(size))
+{
+    return (Arena *) AllocSetContextCreate(
+        CurrentMemoryContext,
+        "query_int compilation",
+# if PG_VERSION_NUM >= 90600
+        ALLOCSET_DEFAULT_SIZES
+# else
+        ALLOCSET_DEFAULT_MINSIZE,
+        ALLOCSET_DEFAULT_INITSIZE,
+        ALLOCSET_DEFAULT_MAXSIZE
+# endif /* PostgreSQL >= 9.6 */
+    );
+}
+
+void *arena_alloc(Arena *this, size_t size)
+{
+    return MemoryContextAlloc((MemoryContext) this, size);
+}
+
+void arena_reset(Arena *this)
+{
+    MemoryContextReset((MemoryContext) this);
+}
+
+void arena_destroy(Arena *this)
+{
+    MemoryContextDelete((MemoryContext) this);
+}
+
+MemoryContext arena_switch_to(Arena *this)
+{
+    return MemoryContextSwitchTo((MemoryContext) this);
+}
+
+#else
+
+# include <stddef.h>
+
+# define ARENA_MIN_SIZE 4096
+
+typedef struct _ArenaChunk {
+    struct _ArenaChunk *next;
+    size_t size;
+    size_t used;
+    /* data follows, aligned on ARENA_ALIGNMENT */
+} ArenaChunk;
+
+struct _Arena {
+    ArenaChunk *head;
+};
+
+# define ARENA_ALIGNMENT \
+    offsetof(struct { char c; union { long double ld; void *p; uint64_t u; } x; }, x)
+
+# define ARENA_ALIGN(size) \
+    (((size) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+# define CHUNK_DATA(chunk) \
+    ((char *) (chunk) + ARENA_ALIGN(sizeof(ArenaChunk)))
+
+static ArenaChunk *arena_chunk_new(size_t size, ArenaChunk *next)
+{
+    ArenaChunk *c;
+
+    c = malloc(ARENA_ALIGN(sizeof(ArenaChunk)) + size);
+    c->next = next;
+    c->size = size;
+    c->used = 0;
+
+    return c;
+}
+
+Arena *arena_new(size_t size)
+{
+    Arena *this;
+
+    this = mem_new(*this);
+    this->head = arena_chunk_new(MAX(size, ARENA_MIN_SIZE), NULL);
+
+    return this;
+}
+
+void *arena_alloc(Arena *this, size_t size)
+{
+    void *ptr;
+
+    size = ARENA_ALIGN(size);
+    if (this->head->size - this->head->used < size) {
+        /* chunks grow geometrically so the number of them stays logarithmic */
+        this->head = arena_chunk_new(MAX(this->head->size << 1, size), this->head);
+    }
+    ptr = CHUNK_DATA(this->head) + this->head->used;
+    this->head->used += size;
+
+    return ptr;
+}
+
+/**
+ * Release everything but the last (and largest) chunk, which is kept for
+ * the next compilation
+ **/
+void arena_reset(Arena *this)
+{
+    ArenaChunk *c, *next;
+
+    for (c = this->head->next; NULL != c; c = next) {
+        next = c->next;
+        free(c);
+    }
+    this->head->next = NULL;
+    this->head->used = 0;
+}
+
+void arena_destroy(Arena *this)
+{
+    arena_reset(this);
+    free(this->head);
+    free(this);
+}
+
+#endif /* POSTGRESQL */
@@ -0,0 +1,33 @@
+#ifndef ARENA_H
+
+# define ARENA_H
+
+# include "common.h"
+
+/**
+ * Bump allocator for the short-lived objects of a compilation (the
+ * pending operators of the parser, the symbol table, the terms of the
+ * simplification, the search and scan buffers of the analysis, the gray
+ * code plans and value stacks of the table generation): they are never
+ * freed individually but all at once by arena_reset or arena_destroy.
+ * In PostgreSQL, an arena is a dedicated child of the current memory
+ * context.
+ **/
+
+typedef struct _Arena Arena;
+
+Arena *arena_new(size_t);
+void *arena_alloc(Arena *, size_t);
+void arena_reset(Arena *);
+void arena_destroy(Arena *);
+# ifdef POSTGRESQL
+MemoryContext arena_switch_to(Arena *);
+# endif /* POSTGRESQL */
+
+# define arena_mem_new(arena, type) \
+    arena_alloc(arena, sizeof(type))
+
+# define arena_mem_new_n(arena, type, n) \
+    arena_alloc(arena, sizeof(type) * (n))
+
+#endif /* !ARENA_H */
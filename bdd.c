@@ -0,0 +1,434 @@
+#include <string.h>
+#include <netinet/in.h>
+
+#include "bdd.h"
+
+#ifdef POSTGRESQL
+# include "miscadmin.h"
+#endif /* POSTGRESQL */
+
+#define BDD_MIN_NODES 64
+#define BDD_MIN_CACHE 4096
+
+typedef struct {
+    uint32_t var;
+    BDDRef low;
+    BDDRef high;
+} BDDNode;
+
+typedef struct {
+    uint32_t op;
+    BDDRef a;
+    BDDRef b;
+    BDDRef r;
+} BDDCacheEntry;
+
+struct _BDD {
+    uint32_t vars;
+    size_t max_nodes;
+    bool overflow;
+#ifndef POSTGRESQL
+    /* recursion depth of bdd_apply (PostgreSQL checks the stack itself) */
+    uint32_t depth;
+    bool too_deep;
+#endif /* !POSTGRESQL */
+    /* nodes */
+    BDDNode *nodes;
+    size_t count;
+    size_t allocated;
+    /* unique table (open addressing, 0 - BDD_FALSE - marks an empty slot) */
+    BDDRef *unique;
+    size_t unique_mask;
+    /* computed table (direct mapped) */
+    BDDCacheEntry *cache;
+    size_t cache_mask;
+    /* serialization */
+    BDDRef *order;
+    uint32_t *ids;
+    size_t ordered;
+};
+
+static inline uint32_t bdd_mix(uint32_t a, uint32_t b, uint32_t c)
+{
+    uint32_t h;
+
+    h = a * UINT32_C(0x9E3779B1);
+    h ^= b + UINT32_C(0x7F4A7C15) + (h << 6) + (h >> 2);
+    h ^= c + UINT32_C(0x165667B1) + (h << 6) + (h >> 2);
+    h ^= h >> 15;
+    h *= UINT32_C(0x2C1B3C6D);
+    h ^= h >> 12;
+
+    return h;
+}
+
+BDD *bdd_new(uint32_t vars, size_t max_nodes)
+{
+    BDD *this;
+
+    this = mem_new(*this);
+    this->vars = vars;
+    this->max_nodes = MAX(max_nodes, 2);
+    this->overflow = FALSE;
+#ifndef POSTGRESQL
+    this->depth = 0;
+    this->too_deep = FALSE;
+#endif /* !POSTGRESQL */
+    this->allocated = BDD_MIN_NODES;
+    this->nodes = mem_new_n(*this->nodes, this->allocated);
+    this->nodes[BDD_FALSE].var = this->nodes[BDD_TRUE].var = vars;
+    this->nodes[BDD_FALSE].low = this->nodes[BDD_FALSE].high = BDD_FALSE;
+    this->nodes[BDD_TRUE].low = this->nodes[BDD_TRUE].high = BDD_TRUE;
+    this->count = 2;
+    this->unique_mask = 2 * BDD_MIN_NODES - 1;
+    this->unique = mem_new_n(*this->unique, this->unique_mask + 1);
+    memset(this->unique, 0, (this->unique_mask + 1) * sizeof(*this->unique));
+    this->cache_mask = BDD_MIN_CACHE - 1;
+    this->cache = mem_new_n(*this->cache, this->cache_mask + 1);
+    memset(this->cache, 0, (this->cache_mask + 1) * sizeof(*this->cache));
+    this->order = NULL;
+    this->ids = NULL;
+    this->ordered = 0;
+
+    return this;
+}
+
+static void bdd_unique_insert(BDD *this, BDDRef ref)
+{
+    size_t i;
+    BDDNode *n;
+
+    n = &this->nodes[ref];
+    for (i = bdd_mix(n->var, n->low, n->high) & this->unique_mask; BDD_FALSE != this->unique[i]; i = (i + 1) & this->unique_mask)
+        ;
+    this->unique[i] = ref;
+}
+
+static void bdd_grow(BDD *this)
+{
+    BDDRef ref;
+
+    this->allocated <<= 1;
+    this->nodes = mem_renew(this->nodes, *this->nodes, this->allocated);
+    /* keep the load factor of the unique table under 1/2 */
+#ifndef NO_NEED_TO_FREE
+    free(this->unique);
+#endif /* !NO_NEED_TO_FREE */
+    this->unique_mask = 2 * this->allocated - 1;
+    this->unique = mem_new_n(*this->unique, this->unique_mask + 1);
+    memset(this->unique, 0, (this->unique_mask + 1) * sizeof(*this->unique));
+    for (ref = BDD_TRUE + 1; ref < this->count; ref++) {
+        bdd_unique_insert(this, ref);
+    }
+    /* and the computed table proportional to the number of nodes */
+    if (this->cache_mask + 1 < this->allocated) {
+#ifndef NO_NEED_TO_FREE
+        free(this->cache);
+#endif /* !NO_NEED_TO_FREE */
+        this->cache_mask = this->allocated - 1;
+        this->cache = mem_new_n(*this->cache, this->cache_mask + 1);
+        memset(this->cache, 0, (this->cache_mask + 1) * sizeof(*this->cache));
+    }
+}
+
+static BDDRef bdd_mk(BDD *this, uint32_t var, BDDRef low, BDDRef high)
+{
+    size_t i;
+    BDDRef ref;
+    BDDNode *n;
+
+    if (low == high) {
+        return low;
+    }
+    for (i = bdd_mix(var, low, high) & this->unique_mask; BDD_FALSE != (ref = this->unique[i]); i = (i + 1) & this->unique_mask) {
+        n = &this->nodes[ref];
+        if (n->var == var && n->low == low && n->high == high) {
+            return ref;
+        }
+    }
+    if (this->count >= this->max_nodes) {
+        this->overflow = TRUE;
+        return BDD_FALSE;
+    }
+    ref = this->count++;
+    n = &this->nodes[ref];
+    n->var = var;
+    n->low = low;
+    n->high = high;
+    this->unique[i] = ref;
+    if (this->count >= this->allocated) {
+        bdd_grow(this);
+    }
+
+    return ref;
+}
+
+static BDDRef bdd_apply(BDD *this, Opcode op, BDDRef a, BDDRef b)
+{
+    uint32_t var;
+    BDDRef r, tmp;
+    BDDCacheEntry *e;
+    BDDNode *na, *nb;
+
+    if (this->overflow) {
+        return BDD_FALSE;
+    }
+    switch (op) {
+        case OP_AND:
+            if (BDD_FALSE == a || BDD_FALSE == b) {
+                return BDD_FALSE;
+            }
+            if (BDD_TRUE == a || a == b) {
+                return b;
+            }
+            if (BDD_TRUE == b) {
+                return a;
+            }
+            break;
+        case OP_OR:
+            if (BDD_TRUE == a || BDD_TRUE == b) {
+                return BDD_TRUE;
+            }
+            if (BDD_FALSE == a || a == b) {
+                return b;
+            }
+            if (BDD_FALSE == b) {
+                return a;
+            }
+            break;
+        case OP_XOR:
+            if (a == b) {
+                return BDD_FALSE;
+            }
+            if (BDD_FALSE == a) {
+                return b;
+            }
+            if (BDD_FALSE == b) {
+                return a;
+            }
+            if (BDD_TRUE == a && BDD_TRUE == b) {
+                return BDD_FALSE;
+            }
+            break;
+        default:
+            assert(FALSE);
+            return BDD_FALSE;
+    }
+    /* all operators are commutative */
+    if (a > b) {
+        tmp = a;
+        a = b;
+        b = tmp;
+    }
+    e = &this->cache[bdd_mix(op, a, b) & this->cache_mask];
+    if (e->op == (uint32_t) op && e->a == a && e->b == b) {
+        return e->r;
+    }
+    na = &this->nodes[a];
+    nb = &this->nodes[b];
+    var = MIN(na->var, nb->var);
+    {
+        BDDRef a_low, a_high, b_low, b_high, low, high;
+
+        if (na->var == var) {
+            a_low = na->low;
+            a_high = na->high;
+        } else {
+            a_low = a_high = a;
+        }
+        if (nb->var == var) {
+            b_low = nb->low;
+            b_high = nb->high;
+        } else {
+            b_low = b_high = b;
+        }
+        /* each level tests a greater variable: the depth is at most the number of variables */
+#ifdef POSTGRESQL
+        check_stack_depth();
+#else
+        if (this->depth >= BDD_MAX_DEPTH) {
+            this->overflow = this->too_deep = TRUE;
+            return BDD_FALSE;
+        }
+        ++this->depth;
+#endif /* POSTGRESQL */
+        /* na and nb may be invalidated by a reallocation */
+        low = bdd_apply(this, op, a_low, b_low);
+        high = bdd_apply(this, op, a_high, b_high);
+#ifndef POSTGRESQL
+        --this->depth;
+#endif /* !POSTGRESQL */
+        r = bdd_mk(this, var, low, high);
+    }
+    if (!this->overflow) {
+        /* the cache may have been reallocated too */
+        e = &this->cache[bdd_mix(op, a, b) & this->cache_mask];
+        e->op = op;
+        e->a = a;
+        e->b = b;
+        e->r = r;
+    }
+
+    return r;
+}
+
+bool bdd_build(BDD *this, const Program *program, BDDRef *root)
+{
+    BDDRef *stack, *sp;
+    const Instruction *pc;
+
+    assert(NULL != program->code);
+
+    stack = sp = mem_new_n(*stack, program->max_depth + program->temporaries);
+    for (pc = program->code; OP_END != OPCODE(*pc) && !this->overflow; pc++) {
+        switch (OPCODE(*pc)) {
+            case OP_PUSH:
+                assert(OPERAND(*pc) < this->vars);
+                *sp++ = bdd_mk(this, OPERAND(*pc), BDD_FALSE, BDD_TRUE);
+                break;
+            case OP_NOT:
+                sp[-1] = bdd_apply(this, OP_XOR, sp[-1], BDD_TRUE);
+                break;
+            case OP_LOAD:
+                *sp++ = stack[OPERAND(*pc)];
+                break;
+            case OP_STORE:
+                stack[OPERAND(*pc)] = sp[-1];
+                break;
+            default:
+                --sp;
+                sp[-1] = bdd_apply(this, OPCODE(*pc), sp[-1], *sp);
+                break;
+        }
+    }
+    *root = stack[0];
+#ifndef NO_NEED_TO_FREE
+    free(stack);
+#endif /* !NO_NEED_TO_FREE */
+
+    return !this->overflow;
+}
+
+#ifndef POSTGRESQL
+bool bdd_too_deep(BDD *this)
+{
+    return this->too_deep;
+}
+#endif /* !POSTGRESQL */
+
+/**
+ * Post-order numbering of the nodes reachable from root without
+ * recursion: a node stays on the stack until both its children are
+ * numbered (a path is at most vars + 1 nodes long).
+ **/
+static void bdd_number(BDD *this, BDDRef root)
+{
+    size_t depth;
+    BDDRef ref, *stack;
+    BDDNode *n;
+
+    if (BDD_IS_TERMINAL(root)) {
+        return;
+    }
+    stack = mem_new_n(*stack, this->vars + 1);
+    depth = 0;
+    stack[depth++] = root;
+    while (depth > 0) {
+        ref = stack[depth - 1];
+        n = &this->nodes[ref];
+        if (!BDD_IS_TERMINAL(n->low) && 0 == this->ids[n->low]) {
+            stack[depth++] = n->low;
+        } else if (!BDD_IS_TERMINAL(n->high) && 0 == this->ids[n->high]) {
+            stack[depth++] = n->high;
+        } else {
+            --depth;
+            this->order[this->ordered++] = ref;
+            this->ids[ref] = this->ordered + BDD_TRUE; /* the first one gets BDD_TRUE + 1 */
+        }
+    }
+#ifndef NO_NEED_TO_FREE
+    free(stack);
+#endif /* !NO_NEED_TO_FREE */
+}
+
+/**
+ * Number the nodes reachable from root in post-order (low before high),
+ * which only depends on the function for a given variable order, and
+ * return their count (terminals excluded)
+ **/
+size_t bdd_count(BDD *this, BDDRef root)
+{
+    if (NULL == this->ids) {
+        this->order = mem_new_n(*this->order, this->count);
+        this->ids = mem_new_n(*this->ids, this->count);
+        memset(this->ids, 0, this->count * sizeof(*this->ids));
+        this->ordered = 0;
+        bdd_number(this, root);
+    }
+
+    return this->ordered;
+}
+
+#define WRITE_UINT32(var, var_len, value) \
+    do { \
+        uint32_t v = htonl(value); \
+        memcpy(var + var_len, &v, sizeof(v)); \
+        var_len += sizeof(v); \
+    } while (0);
+
+#define SERIALIZED_REF(this, ref) \
+    (BDD_IS_TERMINAL(ref) ? (ref) : (this)->ids[ref])
+
+/**
+ * Set support[v] to TRUE for each variable v tested by a node reachable
+ * from root (the others don't have any influence on the function)
+ **/
+void bdd_support(BDD *this, BDDRef root, bool *support)
+{
+    size_t i;
+
+    bdd_count(this, root);
+    for (i = 0; i < this->ordered; i++) {
+        support[this->nodes[this->order[i]].var] = TRUE;
+    }
+}
+
+/**
+ * Write, in network byte order, the number of nodes, then, for each of
+ * them: its variable (renumbered through vars if not NULL), low and high
+ * children (0 and 1 for the terminals, n + 2 for the nth node written)
+ * and finally the root.
+ * Buffer should be at least (2 + 3 * bdd_count()) * sizeof(uint32_t).
+ **/
+size_t bdd_serialize(BDD *this, BDDRef root, const uint32_t *vars, uint8_t *buffer)
+{
+    size_t i, len;
+
+    len = 0;
+    WRITE_UINT32(buffer, len, bdd_count(this, root));
+    for (i = 0; i < this->ordered; i++) {
+        BDDNode *n;
+
+        n = &this->nodes[this->order[i]];
+        WRITE_UINT32(buffer, len, NULL == vars ? n->var : vars[n->var]);
+        WRITE_UINT32(buffer, len, SERIALIZED_REF(this, n->low));
+        WRITE_UINT32(buffer, len, SERIALIZED_REF(this, n->high));
+    }
+    WRITE_UINT32(buffer, len, SERIALIZED_REF(this, root));
+
+    return len;
+}
+
+void bdd_destroy(BDD *this)
+{
+#ifndef NO_NEED_TO_FREE
+    if (NULL != this->ids) {
+        free(this->ids);
+        free(this->order);
+    }
+    free(this->cache);
+    free(this->unique);
+    free(this->nodes);
+    free(this);
+#endif /* !NO_NEED_TO_FREE */
+}
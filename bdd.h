@@ -0,0 +1,44 @@
+#ifndef BDD_H
+
+# define BDD_H
+
+# include "common.h"
+# include "program.h"
+
+/**
+ * Reduced ordered binary decision diagram of a program: variables are
+ * the operands of OP_PUSH, tested in increasing order (variable 0 at the
+ * top). Nodes are referenced by their index, the 2 first ones being the
+ * terminals BDD_FALSE and BDD_TRUE.
+ * Nodes are never freed while building: the maximum given to bdd_new
+ * bounds all the nodes created, intermediate results included, not only
+ * those of the final diagram.
+ * The operations recurse once per variable along a path: in PostgreSQL
+ * the stack depth is checked, elsewhere bdd_build fails (bdd_too_deep)
+ * beyond BDD_MAX_DEPTH levels.
+ **/
+
+typedef struct _BDD BDD;
+typedef uint32_t BDDRef;
+
+# define BDD_FALSE ((BDDRef) 0)
+# define BDD_TRUE  ((BDDRef) 1)
+
+# define BDD_IS_TERMINAL(ref) \
+    ((ref) <= BDD_TRUE)
+
+# ifndef POSTGRESQL
+#  define BDD_MAX_DEPTH 16384
+# endif /* !POSTGRESQL */
+
+BDD *bdd_new(uint32_t, size_t);
+bool bdd_build(BDD *, const Program *, BDDRef *);
+# ifndef POSTGRESQL
+bool bdd_too_deep(BDD *);
+# endif /* !POSTGRESQL */
+size_t bdd_count(BDD *, BDDRef);
+void bdd_support(BDD *, BDDRef, bool *);
+size_t bdd_serialize(BDD *, BDDRef, const uint32_t *, uint8_t *);
+void bdd_destroy(BDD *);
+
+#endif /* !BDD_H */
@@ -0,0 +1,324 @@
+/**
+ * Benchmark of the standalone compiler on a reproducible corpus of random
+ * expressions: validation (syntax only), parsing (symbol interning
+ * included), analysis (simplification, detection of constants and
+ * irrelevant symbols) and table generation are timed separately, each one
+ * over the whole corpus, and the best of several runs is reported as JSON
+ * on stdout.
+ * parser.c is included so its (static) functions can be called directly.
+ **/
+#define BENCHMARK 1
+#include "parser.c"
+
+#include <time.h>
+#include <sys/resource.h>
+
+#define BENCH_DEFAULT_EXPRESSIONS 10000
+#define BENCH_DEFAULT_SYMBOLS 8
+#define BENCH_DEFAULT_DEPTH 6
+#define BENCH_DEFAULT_OPERATORS "&|!"
+#ifdef WITH_EXTRA_XOR
+# define BENCH_OPERATORS "&|!^"
+#else
+# define BENCH_OPERATORS "&|!"
+#endif /* WITH_EXTRA_XOR */
+#define BENCH_DEFAULT_PARENTHESES 30 /* % */
+#define BENCH_DEFAULT_WHITESPACES 10 /* % */
+#define BENCH_DEFAULT_RUNS 5
+
+typedef struct {
+    uint64_t seed;
+    unsigned long expressions;
+    unsigned long symbols;
+    unsigned long depth;
+    const char *operators;
+    unsigned long parentheses;
+    unsigned long whitespaces;
+    unsigned long runs;
+} BenchOptions;
+
+typedef struct {
+    char *buffer;
+    size_t length, allocated;
+    size_t *offsets; /* expression i is [offsets[i];offsets[i + 1][ */
+    uint32_t *values; /* the symbols */
+    uint64_t state;
+} Corpus;
+
+/* xorshift64*, for a corpus which only depends on the seed */
+static uint64_t bench_random(Corpus *corpus)
+{
+    corpus->state ^= corpus->state >> 12;
+    corpus->state ^= corpus->state << 25;
+    corpus->state ^= corpus->state >> 27;
+
+    return corpus->state * UINT64_C(0x2545F4914F6CDD1D);
+}
+
+static bool bench_chance(Corpus *corpus, unsigned long percent)
+{
+    return bench_random(corpus) % 100 < percent;
+}
+
+static void corpus_append(Corpus *corpus, const char *str, size_t len)
+{
+    if (corpus->length + len > corpus->allocated) {
+        corpus->allocated = MAX(corpus->allocated * 2, corpus->length + len);
+        corpus->buffer = realloc(corpus->buffer, corpus->allocated);
+    }
+    memcpy(corpus->buffer + corpus->length, str, len);
+    corpus->length += len;
+}
+
+static void corpus_space(Corpus *corpus, const BenchOptions *options)
+{
+    if (bench_chance(corpus, options->whitespaces)) {
+        corpus_append(corpus, " ", 1);
+    }
+}
+
+static void corpus_expression(Corpus *corpus, const BenchOptions *options, unsigned long depth)
+{
+    char op;
+
+    /* a quarter of leaves before the maximum depth */
+    if (0 == depth || 0 == bench_random(corpus) % 4) {
+        int len;
+        char symbol[sizeof("4294967295")];
+
+        len = snprintf(symbol, sizeof(symbol), "%" PRIu32, corpus->values[bench_random(corpus) % options->symbols]);
+        corpus_append(corpus, symbol, len);
+        return;
+    }
+    op = options->operators[bench_random(corpus) % strlen(options->operators)];
+    if ('!' == op) {
+        corpus_append(corpus, &op, 1);
+        corpus_space(corpus, options);
+        corpus_expression(corpus, options, depth - 1);
+    } else {
+        bool parentheses;
+
+        if ((parentheses = bench_chance(corpus, options->parentheses))) {
+            corpus_append(corpus, "(", 1);
+        }
+        corpus_expression(corpus, options, depth - 1);
+        corpus_space(corpus, options);
+        corpus_append(corpus, &op, 1);
+        corpus_space(corpus, options);
+        corpus_expression(corpus, options, depth - 1);
+        if (parentheses) {
+            corpus_append(corpus, ")", 1);
+        }
+    }
+}
+
+static void corpus_generate(Corpus *corpus, const BenchOptions *options)
+{
+    unsigned long i;
+
+    memset(corpus, 0, sizeof(*corpus));
+    corpus->state = 0 == options->seed ? 1 : options->seed;
+    /* distinct values (by their remainder modulo the number of symbols) but not consecutive */
+    corpus->values = mem_new_n(*corpus->values, options->symbols);
+    for (i = 0; i < options->symbols; i++) {
+        corpus->values[i] = 1 + i + options->symbols * (bench_random(corpus) % 1000);
+    }
+    corpus->offsets = mem_new_n(*corpus->offsets, options->expressions + 1);
+    for (i = 0; i < options->expressions; i++) {
+        corpus->offsets[i] = corpus->length;
+        corpus_expression(corpus, options, options->depth);
+    }
+    corpus->offsets[i] = corpus->length;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef struct {
+    double validate, parse, analyze, table; /* ns, for the whole corpus */
+    uint64_t rows, symbols;
+    unsigned long invalid, errors;
+} BenchRun;
+
+static void bench_run(const Corpus *corpus, const BenchOptions *options, Arena *arena, ParseResult *results, bool *parsed, BenchRun *run)
+{
+    double start;
+    unsigned long i;
+    size_t h_size;
+    uint8_t *h, all_true, all_false;
+
+    arena_reset(arena);
+    run->rows = run->symbols = 0;
+    run->invalid = run->errors = 0;
+    start = bench_now();
+    for (i = 0; i < options->expressions; i++) {
+        size_t symbols;
+
+        if (validate(corpus->buffer + corpus->offsets[i], corpus->buffer + corpus->offsets[i + 1], &symbols)) {
+            run->symbols += symbols;
+        } else {
+            ++run->invalid;
+        }
+    }
+    run->validate = bench_now() - start;
+    start = bench_now();
+    for (i = 0; i < options->expressions; i++) {
+        parsed[i] = parse(arena, corpus->buffer + corpus->offsets[i], corpus->buffer + corpus->offsets[i + 1], &results[i]);
+    }
+    run->parse = bench_now() - start;
+    start = bench_now();
+    for (i = 0; i < options->expressions; i++) {
+        if (parsed[i]) {
+            simplify(&results[i]);
+            detect_constant(&results[i]);
+            eliminate_vacuous(&results[i], sizeof(uint32_t) * CHAR_BIT - 1);
+        }
+    }
+    run->analyze = bench_now() - start;
+    start = bench_now();
+    for (i = 0; i < options->expressions; i++) {
+        if (parsed[i]) {
+            if (SAT_UNKNOWN == results[i].constant) {
+                run->rows += UINT64_C(1) << results[i].relevant_count;
+            }
+            h = compute_hash(&h_size, &results[i], &all_true, &all_false);
+            free(h);
+        } else {
+            ++run->errors;
+        }
+    }
+    run->table = bench_now() - start;
+    for (i = 0; i < options->expressions; i++) {
+        program_free(&results[i].program);
+    }
+}
+
+static void bench_usage(void)
+{
+    fprintf(
+        stderr,
+        "%s: [-s SEED] [-n EXPRESSIONS] [-m SYMBOLS] [-d DEPTH] [-o OPERATORS] [-p PARENTHESES%%] [-w WHITESPACES%%] [-r RUNS] [-j THREADS]\n",
+        "query_int_bench"
+    );
+    exit(EXIT_USAGE);
+}
+
+static unsigned long bench_number(const char *str, unsigned long min, unsigned long max)
+{
+    char *endptr;
+    unsigned long value;
+
+    value = strtoul(str, &endptr, 10);
+    if ('\0' == *str || '\0' != *endptr || value < min || value > max) {
+        bench_usage();
+    }
+
+    return value;
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    Arena *arena;
+    Corpus corpus;
+    bool *parsed;
+    unsigned long r;
+    struct rusage usage;
+    BenchOptions options;
+    ParseResult *results;
+    BenchRun run, best;
+
+    options.seed = 1;
+    options.expressions = BENCH_DEFAULT_EXPRESSIONS;
+    options.symbols = BENCH_DEFAULT_SYMBOLS;
+    options.depth = BENCH_DEFAULT_DEPTH;
+    options.operators = BENCH_DEFAULT_OPERATORS;
+    options.parentheses = BENCH_DEFAULT_PARENTHESES;
+    options.whitespaces = BENCH_DEFAULT_WHITESPACES;
+    options.runs = BENCH_DEFAULT_RUNS;
+    while (-1 != (c = getopt(argc, argv, "d:j:m:n:o:p:r:s:w:"))) {
+        switch (c) {
+            case 'd':
+                options.depth = bench_number(optarg, 0, 16);
+                break;
+            case 'j':
+                table_threads = bench_number(optarg, 1, LONG_MAX);
+                break;
+            case 'm':
+                /* every generated expression has to fit in a table */
+                options.symbols = bench_number(optarg, 1, sizeof(uint32_t) * CHAR_BIT - 1);
+                break;
+            case 'n':
+                options.expressions = bench_number(optarg, 1, ULONG_MAX - 1);
+                break;
+            case 'o':
+                if ('\0' == *optarg || strlen(optarg) != strspn(optarg, BENCH_OPERATORS)) {
+                    bench_usage();
+                }
+                options.operators = optarg;
+                break;
+            case 'p':
+                options.parentheses = bench_number(optarg, 0, 100);
+                break;
+            case 'r':
+                options.runs = bench_number(optarg, 1, ULONG_MAX);
+                break;
+            case 's':
+                options.seed = bench_number(optarg, 0, ULONG_MAX);
+                break;
+            case 'w':
+                options.whitespaces = bench_number(optarg, 0, 100);
+                break;
+            default:
+                bench_usage();
+                break;
+        }
+    }
+    if (optind != argc) {
+        bench_usage();
+    }
+    verbose = FALSE;
+    quiet = TRUE;
+    compile_start_states();
+    corpus_generate(&corpus, &options);
+    arena = arena_new(0);
+    results = mem_new_n(*results, options.expressions);
+    parsed = mem_new_n(*parsed, options.expressions);
+    for (r = 0; r < options.runs; r++) {
+        bench_run(&corpus, &options, arena, results, parsed, &run);
+        if (0 == r) {
+            best = run;
+        } else {
+            best.validate = MIN(best.validate, run.validate);
+            best.parse = MIN(best.parse, run.parse);
+            best.analyze = MIN(best.analyze, run.analyze);
+            best.table = MIN(best.table, run.table);
+        }
+    }
+    getrusage(RUSAGE_SELF, &usage);
+    printf("{\n");
+    printf("  \"seed\": %" PRIu64 ", \"expressions\": %lu, \"symbols\": %lu, \"depth\": %lu, \"operators\": \"%s\",\n", options.seed, options.expressions, options.symbols, options.depth, options.operators);
+    printf("  \"parentheses\": %lu, \"whitespaces\": %lu, \"runs\": %lu, \"threads\": %ld, \"lanes\": %u,\n", options.parentheses, options.whitespaces, options.runs, table_threads, 1U << table_kernel_shift);
+    printf("  \"bytes\": %" PRIszu ", \"invalid\": %lu, \"errors\": %lu, \"distinct_symbols\": %" PRIu64 ", \"rows\": %" PRIu64 ",\n", corpus.length, best.invalid, best.errors, best.symbols, best.rows);
+    printf("  \"validate\": {\"ns_per_expr\": %.1f, \"mb_per_s\": %.1f},\n", best.validate / options.expressions, corpus.length / best.validate * 1e3);
+    printf("  \"parse\": {\"ns_per_expr\": %.1f, \"mb_per_s\": %.1f},\n", best.parse / options.expressions, corpus.length / best.parse * 1e3);
+    printf("  \"analyze\": {\"ns_per_expr\": %.1f},\n", best.analyze / options.expressions);
+    printf("  \"table\": {\"ns_per_expr\": %.1f, \"rows_per_s\": %.0f},\n", best.table / options.expressions, best.rows / best.table * 1e9);
+    printf("  \"total\": {\"ns_per_expr\": %.1f},\n", (best.parse + best.analyze + best.table) / options.expressions);
+    printf("  \"max_rss_kb\": %ld\n", usage.ru_maxrss);
+    printf("}\n");
+    arena_destroy(arena);
+    free(results);
+    free(parsed);
+    free(corpus.offsets);
+    free(corpus.values);
+    free(corpus.buffer);
+
+    return EXIT_SUCCESS;
+}
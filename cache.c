@@ -0,0 +1,233 @@
+#include <string.h>
+
+#include "cache.h"
+
+#ifdef POSTGRESQL
+# include "utils/memutils.h"
+# define CACHE_ALLOC(this, size) \
+    MemoryContextAlloc((this)->context, size)
+# define CACHE_FREE(ptr) \
+    pfree(ptr)
+#else
+# define CACHE_ALLOC(this, size) \
+    malloc(size)
+# define CACHE_FREE(ptr) \
+    free(ptr)
+#endif /* POSTGRESQL */
+
+#define CACHE_MIN_BUCKETS 64
+
+typedef struct _CacheEntry {
+    struct _CacheEntry *next; /* next in bucket */
+    struct _CacheEntry *lru_prev, *lru_next;
+    uint64_t hash;
+    size_t key_len;
+    size_t size; /* of the whole entry (header, key and result) */
+    CachedResult result;
+    /* key then result data follow */
+} CacheEntry;
+
+struct _Cache {
+#ifdef POSTGRESQL
+    MemoryContext context;
+#endif /* POSTGRESQL */
+    CacheEntry **buckets;
+    size_t mask;
+    /* most recently used first */
+    CacheEntry *lru_head, *lru_tail;
+    CacheStats stats;
+};
+
+#define ENTRY_KEY(entry) \
+    ((char *) ((entry) + 1))
+
+static uint64_t cache_hash(const char *key, size_t key_len)
+{
+    size_t i;
+    uint64_t hash;
+
+    /* FNV-1a */
+    hash = UINT64_C(0xCBF29CE484222325);
+    for (i = 0; i < key_len; i++) {
+        hash ^= (unsigned char) key[i];
+        hash *= UINT64_C(0x100000001B3);
+    }
+
+    return hash;
+}
+
+Cache *cache_new(void)
+{
+    Cache *this;
+#ifdef POSTGRESQL
+    MemoryContext context;
+
+    context = AllocSetContextCreate(
+        TopMemoryContext,
+        "query_int cache",
+# if PG_VERSION_NUM >= 90600
+        ALLOCSET_DEFAULT_SIZES
+# else
+        ALLOCSET_DEFAULT_MINSIZE,
+        ALLOCSET_DEFAULT_INITSIZE,
+        ALLOCSET_DEFAULT_MAXSIZE
+# endif /* PostgreSQL >= 9.6 */
+    );
+    this = MemoryContextAlloc(context, sizeof(*this));
+    this->context = context;
+#else
+    this = mem_new(*this);
+#endif /* POSTGRESQL */
+    this->mask = CACHE_MIN_BUCKETS - 1;
+    this->buckets = CACHE_ALLOC(this, (this->mask + 1) * sizeof(*this->buckets));
+    memset(this->buckets, 0, (this->mask + 1) * sizeof(*this->buckets));
+    this->lru_head = this->lru_tail = NULL;
+    memset(&this->stats, 0, sizeof(this->stats));
+
+    return this;
+}
+
+static void cache_lru_unlink(Cache *this, CacheEntry *e)
+{
+    if (NULL == e->lru_prev) {
+        this->lru_head = e->lru_next;
+    } else {
+        e->lru_prev->lru_next = e->lru_next;
+    }
+    if (NULL == e->lru_next) {
+        this->lru_tail = e->lru_prev;
+    } else {
+        e->lru_next->lru_prev = e->lru_prev;
+    }
+}
+
+static void cache_lru_push(Cache *this, CacheEntry *e)
+{
+    e->lru_prev = NULL;
+    e->lru_next = this->lru_head;
+    if (NULL == this->lru_head) {
+        this->lru_tail = e;
+    } else {
+        this->lru_head->lru_prev = e;
+    }
+    this->lru_head = e;
+}
+
+/**
+ * Look for the result of key: on success, result points into the cache
+ * and is only valid until the next insertion
+ **/
+bool cache_lookup(Cache *this, const char *key, size_t key_len, CachedResult *result)
+{
+    uint64_t hash;
+    CacheEntry *e;
+
+    hash = cache_hash(key, key_len);
+    for (e = this->buckets[hash & this->mask]; NULL != e; e = e->next) {
+        if (e->hash == hash && e->key_len == key_len && 0 == memcmp(ENTRY_KEY(e), key, key_len)) {
+            cache_lru_unlink(this, e);
+            cache_lru_push(this, e);
+            *result = e->result;
+            ++this->stats.hits;
+            return TRUE;
+        }
+    }
+    ++this->stats.misses;
+
+    return FALSE;
+}
+
+/**
+ * Count a hit served without cache_lookup (like a per call site cache)
+ **/
+void cache_hit(Cache *this)
+{
+    ++this->stats.hits;
+}
+
+static void cache_evict(Cache *this, CacheEntry *e)
+{
+    CacheEntry **prev;
+
+    for (prev = &this->buckets[e->hash & this->mask]; *prev != e; prev = &(*prev)->next)
+        ;
+    *prev = e->next;
+    cache_lru_unlink(this, e);
+    --this->stats.entries;
+    this->stats.size -= e->size;
+    CACHE_FREE(e);
+}
+
+static void cache_grow(Cache *this)
+{
+    size_t i, mask;
+    CacheEntry **buckets, *e, *next;
+
+    mask = 2 * (this->mask + 1) - 1;
+    buckets = CACHE_ALLOC(this, (mask + 1) * sizeof(*buckets));
+    memset(buckets, 0, (mask + 1) * sizeof(*buckets));
+    for (i = 0; i <= this->mask; i++) {
+        for (e = this->buckets[i]; NULL != e; e = next) {
+            next = e->next;
+            e->next = buckets[e->hash & mask];
+            buckets[e->hash & mask] = e;
+        }
+    }
+    CACHE_FREE(this->buckets);
+    this->buckets = buckets;
+    this->mask = mask;
+}
+
+/**
+ * Add a copy of result for key (which is expected to not be already
+ * there) then evict the least recently used entries while the cache is
+ * larger than max_size bytes. A result which can't fit alone in max_size
+ * bytes is not kept.
+ **/
+void cache_insert(Cache *this, const char *key, size_t key_len, const CachedResult *result, size_t max_size)
+{
+    size_t size;
+    CacheEntry *e;
+
+    size = sizeof(*e) + key_len + result->size;
+    if (size > max_size) {
+        return;
+    }
+    while (NULL != this->lru_tail && this->stats.size + size > max_size) {
+        cache_evict(this, this->lru_tail);
+    }
+    if (this->stats.entries > this->mask) {
+        cache_grow(this);
+    }
+    e = CACHE_ALLOC(this, size);
+    e->hash = cache_hash(key, key_len);
+    e->key_len = key_len;
+    e->size = size;
+    memcpy(ENTRY_KEY(e), key, key_len);
+    e->result = *result;
+    e->result.data = (uint8_t *) ENTRY_KEY(e) + key_len;
+    memcpy((uint8_t *) e->result.data, result->data, result->size);
+    e->next = this->buckets[e->hash & this->mask];
+    this->buckets[e->hash & this->mask] = e;
+    cache_lru_push(this, e);
+    ++this->stats.entries;
+    this->stats.size += size;
+}
+
+void cache_stats(Cache *this, CacheStats *stats)
+{
+    *stats = this->stats;
+}
+
+void cache_destroy(Cache *this)
+{
+#ifdef POSTGRESQL
+    MemoryContextDelete(this->context);
+#else
+    while (NULL != this->lru_tail) {
+        cache_evict(this, this->lru_tail);
+    }
+    free(this->buckets);
+    free(this);
+#endif /* POSTGRESQL */
+}
@@ -0,0 +1,39 @@
+#ifndef CACHE_H
+
+# define CACHE_H
+
+# include "common.h"
+
+/**
+ * Bounded LRU cache of compiled query_int: keys and results are opaque
+ * byte strings, copied in the cache which owns them. When an insertion
+ * makes the total size exceed the given maximum, the least recently used
+ * entries are evicted.
+ * In PostgreSQL, the cache lives in its own child of TopMemoryContext,
+ * for the lifetime of the backend.
+ **/
+
+typedef struct _Cache Cache;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    uint8_t all_true;
+    uint8_t all_false;
+} CachedResult;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    size_t entries;
+    size_t size;
+} CacheStats;
+
+Cache *cache_new(void);
+bool cache_lookup(Cache *, const char *, size_t, CachedResult *);
+void cache_insert(Cache *, const char *, size_t, const CachedResult *, size_t);
+void cache_hit(Cache *);
+void cache_stats(Cache *, CacheStats *);
+void cache_destroy(Cache *);
+
+#endif /* !CACHE_H */
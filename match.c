@@ -0,0 +1,252 @@
+#include <string.h>
+#include <netinet/in.h>
+
+#include "match.h"
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif /* __SSE2__ */
+
+#define MATCH_TABLE_SIZE(count) \
+    ((((size_t) 1 << (count)) + CHAR_BIT - 1) / CHAR_BIT)
+
+/* row r of the table is the bit (r + 4) % 8 of its byte (see NIBBLE_SWAP in parser.c) */
+#define MATCH_BIT(table, r) \
+    (0 != ((table)[(r) / CHAR_BIT] & (1 << (((r) + 4) % CHAR_BIT))))
+
+static uint32_t read_uint32(const uint8_t *p)
+{
+    uint32_t value;
+
+    memcpy(&value, p, sizeof(value));
+
+    return ntohl(value);
+}
+
+/**
+ * Check that [buffer;buffer + size[ has the layout of the output of
+ * compute_hash (a tautology or a contradiction having no symbol and a
+ * single byte of table) and that its symbols are sorted, then initialize
+ * query on it.
+ * Returns FALSE if the buffer is not a compiled query.
+ **/
+bool compiled_query_init(CompiledQuery *query, const uint8_t *buffer, size_t size)
+{
+    uint32_t s, p;
+
+    if (size < sizeof(uint32_t)) {
+        return FALSE;
+    }
+    query->count = read_uint32(buffer);
+    if (query->count > COMPILED_QUERY_MAX_SYMBOLS || size != sizeof(uint32_t) * (1 + query->count) + MATCH_TABLE_SIZE(query->count)) {
+        return FALSE;
+    }
+    for (s = 0; s < query->count; s++) {
+        query->symbols[s] = read_uint32(buffer + sizeof(uint32_t) * (1 + s));
+        if (0 != s && query->symbols[s] <= query->symbols[s - 1]) {
+            return FALSE;
+        }
+    }
+    query->table = buffer + sizeof(uint32_t) * (1 + query->count);
+    query->lanes_mask = 0;
+    for (p = 0; p < COMPILED_QUERY_LANES; p++) {
+        if (p < query->count && query->symbols[query->count - 1 - p] <= INT32_MAX) {
+            query->lanes[p] = (int32_t) query->symbols[query->count - 1 - p];
+            query->lanes_mask |= UINT32_C(1) << p;
+        } else {
+            query->lanes[p] = 0;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Fallback of compiled_query_row for the sets which are not sorted: each
+ * value is looked up by a binary search among the symbols.
+ **/
+static uint32_t compiled_query_search(const CompiledQuery *query, const int32_t *values, size_t count)
+{
+    size_t i;
+    uint32_t row, lo, hi, mid;
+
+    row = 0;
+    for (i = 0; i < count; i++) {
+        if (values[i] < 0) {
+            continue;
+        }
+        lo = 0;
+        hi = query->count;
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if (query->symbols[mid] < (uint32_t) values[i]) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < query->count && query->symbols[lo] == (uint32_t) values[i]) {
+            row |= UINT32_C(1) << (query->count - 1 - lo);
+        }
+    }
+
+    return row;
+}
+
+/**
+ * Index of the row of the table for the set of count values: the sorted
+ * set (intarray keeps them sorted) is merged with the symbols.
+ * Duplicates and negative values (which can't be symbols) are allowed.
+ **/
+uint32_t compiled_query_row(const CompiledQuery *query, const int32_t *values, size_t count)
+{
+    size_t i;
+    uint32_t s, row;
+
+    row = s = 0;
+    for (i = 0; i < count; i++) {
+        if (0 != i && values[i] < values[i - 1]) {
+            return compiled_query_search(query, values, count);
+        }
+        if (values[i] < 0) {
+            continue;
+        }
+        while (s < query->count && query->symbols[s] < (uint32_t) values[i]) {
+            ++s;
+        }
+        if (s < query->count && query->symbols[s] == (uint32_t) values[i]) {
+            row |= UINT32_C(1) << (query->count - 1 - s);
+            ++s;
+        }
+    }
+
+    return row;
+}
+
+bool compiled_query_match(const CompiledQuery *query, const int32_t *values, size_t count)
+{
+    uint32_t row;
+
+    row = compiled_query_row(query, values, count);
+
+    return MATCH_BIT(query->table, row);
+}
+
+#ifdef __SSE2__
+/**
+ * Alternative to compiled_query_row for the batches when the set is too
+ * small or not sorted: each value is compared at once to 4 lanes, the
+ * lanes equal to any of the values being the bits of the row. The set is
+ * read again for each vector of lanes, which then stays in a register.
+ **/
+static uint32_t compiled_query_row_sse2(const CompiledQuery *query, const int32_t *values, size_t count)
+{
+    size_t i;
+    uint32_t k, row;
+    __m128i lanes, found;
+
+    row = 0;
+    for (k = 0; 4 * k < query->count; k++) {
+        lanes = _mm_loadu_si128((const __m128i *) (query->lanes + 4 * k));
+        found = _mm_setzero_si128();
+        for (i = 0; i < count; i++) {
+            found = _mm_or_si128(found, _mm_cmpeq_epi32(_mm_set1_epi32(values[i]), lanes));
+        }
+        row |= (uint32_t) _mm_movemask_ps(_mm_castsi128_ps(found)) << (4 * k);
+    }
+
+    return row & query->lanes_mask;
+}
+
+/**
+ * Are the values in ascending order (duplicates allowed)? Compares them,
+ * 4 at a time, to their successors.
+ **/
+static bool compiled_query_sorted_sse2(const int32_t *values, size_t count)
+{
+    size_t i;
+    __m128i disorder;
+
+    disorder = _mm_setzero_si128();
+    for (i = 0; i + 4 < count; i += 4) {
+        disorder = _mm_or_si128(disorder, _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *) (values + i)), _mm_loadu_si128((const __m128i *) (values + i + 1))));
+    }
+    for (; i + 1 < count; i++) {
+        if (values[i] > values[i + 1]) {
+            return FALSE;
+        }
+    }
+
+    return 0 == _mm_movemask_epi8(disorder);
+}
+
+/**
+ * Sorted set intersection of the values (at least 4, in ascending order)
+ * with the lanes (the symbols in descending order): both are merged from
+ * their greatest element, by blocks of 4 compared all against all (the
+ * values being rotated), then the block with the greatest minimum is
+ * consumed (none of its elements can be equal to the remaining ones of
+ * the other). The last block of values overlaps the previous one if count
+ * is not a multiple of 4, comparing some values twice does no harm.
+ **/
+static uint32_t compiled_query_merge_sse2(const CompiledQuery *query, const int32_t *values, size_t count)
+{
+    size_t i, b;
+    uint32_t k, last, row;
+    int32_t vmin, lmin;
+    __m128i v, lanes, found;
+
+    if (0 == query->lanes_mask) {
+        return 0;
+    }
+    row = 0;
+    last = query->count - 1;
+    /* the lanes of the symbols greater than INT32_MAX (the first ones) can't be equal to any value */
+    k = (uint32_t) __builtin_ctz(query->lanes_mask) & ~UINT32_C(3);
+    i = count;
+    while (i > 0 && k <= last) {
+        b = MAX(i, 4) - 4;
+        v = _mm_loadu_si128((const __m128i *) (values + b));
+        lanes = _mm_loadu_si128((const __m128i *) (query->lanes + k));
+        found = _mm_cmpeq_epi32(v, lanes);
+        found = _mm_or_si128(found, _mm_cmpeq_epi32(_mm_shuffle_epi32(v, _MM_SHUFFLE(0, 3, 2, 1)), lanes));
+        found = _mm_or_si128(found, _mm_cmpeq_epi32(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)), lanes));
+        found = _mm_or_si128(found, _mm_cmpeq_epi32(_mm_shuffle_epi32(v, _MM_SHUFFLE(2, 1, 0, 3)), lanes));
+        row |= (uint32_t) _mm_movemask_ps(_mm_castsi128_ps(found)) << k;
+        vmin = values[b];
+        lmin = query->lanes[MIN(k + 3, last)];
+        if (vmin >= lmin) {
+            i = b;
+        }
+        if (lmin >= vmin) {
+            k += 4;
+        }
+    }
+
+    return row & query->lanes_mask;
+}
+#endif /* __SSE2__ */
+
+void compiled_query_match_batch(const CompiledQuery *query, const int32_t *values, const size_t *offsets, size_t count, uint8_t *result)
+{
+    size_t i;
+    uint32_t row;
+
+    memset(result, 0, (count + CHAR_BIT - 1) / CHAR_BIT);
+    for (i = 0; i < count; i++) {
+        if (0 == query->count) {
+            row = 0;
+        } else {
+#ifdef __SSE2__
+            if (offsets[i + 1] - offsets[i] >= 4 && compiled_query_sorted_sse2(values + offsets[i], offsets[i + 1] - offsets[i])) {
+                row = compiled_query_merge_sse2(query, values + offsets[i], offsets[i + 1] - offsets[i]);
+            } else {
+                row = compiled_query_row_sse2(query, values + offsets[i], offsets[i + 1] - offsets[i]);
+            }
+#else
+            row = compiled_query_row(query, values + offsets[i], offsets[i + 1] - offsets[i]);
+#endif /* __SSE2__ */
+        }
+        result[i / CHAR_BIT] |= MATCH_BIT(query->table, row) << (i % CHAR_BIT);
+    }
+}
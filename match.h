@@ -0,0 +1,39 @@
+#ifndef MATCH_H
+
+# define MATCH_H
+
+# include "common.h"
+
+/**
+ * Evaluation of a compiled query (the output of compute_hash: the number
+ * of symbols, the symbols in ascending order, both as big endian uint32,
+ * then the truth table) against a set of integers, without the query
+ * itself: the index of the row of the table is built from the symbols
+ * which belong to the set, the greatest symbol being its lowest bit,
+ * then the bit of this row is read.
+ * The compiled query is only referenced (not copied) by CompiledQuery.
+ *
+ * compiled_query_match_batch evaluates a query over a batch of sets in
+ * CSR form: set i is [values + offsets[i];values + offsets[i + 1][, so
+ * offsets has count + 1 elements. Bit i % 8 of byte i / 8 of the result
+ * (count bits rounded up to bytes) is set if set i matches.
+ **/
+
+# define COMPILED_QUERY_MAX_SYMBOLS (sizeof(uint32_t) * CHAR_BIT - 1)
+# define COMPILED_QUERY_LANES 32
+
+typedef struct {
+    uint32_t count;
+    uint32_t symbols[COMPILED_QUERY_MAX_SYMBOLS]; /* host byte order */
+    const uint8_t *table;
+    /* for compiled_query_match_batch: lane p is the symbol of the bit p of a row, lanes_mask the lanes an int32_t can be equal to */
+    int32_t lanes[COMPILED_QUERY_LANES];
+    uint32_t lanes_mask;
+} CompiledQuery;
+
+bool compiled_query_init(CompiledQuery *, const uint8_t *, size_t);
+uint32_t compiled_query_row(const CompiledQuery *, const int32_t *, size_t);
+bool compiled_query_match(const CompiledQuery *, const int32_t *, size_t);
+void compiled_query_match_batch(const CompiledQuery *, const int32_t *, const size_t *, size_t, uint8_t *);
+
+#endif /* !MATCH_H */
@@ -1,10 +1,56 @@
 #include "common.h"
 #include "parsenum.h"
 
+#define SWAR_ONES(n) (~UINT64_C(0) / 0xFF * (n))
+
+/* little endian load, whatever the byte order of the host (compilers reduce it to a single load) */
+static inline uint64_t swar_load(const char *p, int len)
+{
+    int i;
+    uint64_t word;
+
+    for (word = 0, i = 0; i < len; i++) {
+        word |= (uint64_t) (unsigned char) p[i] << (i * CHAR_BIT);
+    }
+
+    return word;
+}
+
+/* all the (masked) bytes are in ['0';'9']: 0x3X and still 0x3X with 6 added (a carry may only come from a non digit) */
+static inline bool swar_all_digits(uint64_t word, uint64_t mask)
+{
+    return (word & SWAR_ONES(0xF0) & mask) == (SWAR_ONES(0x30) & mask)
+        && ((word + SWAR_ONES(0x06)) & SWAR_ONES(0xF0) & mask) == (SWAR_ONES(0x30) & mask);
+}
+
+/**
+ * Converts the 8 (or 4) digits in word, the first one in its lowest byte:
+ * adjacent digits, then pairs, then quadruplets are combined into twice as
+ * large lanes, in log2(8) = 3 multiplications
+ **/
+static inline uint64_t swar_eight_digits(uint64_t word)
+{
+    word -= SWAR_ONES(0x30);
+    word = (word * 10 + (word >> 8)) & UINT64_C(0x00FF00FF00FF00FF);
+    word = (word * 100 + (word >> 16)) & UINT64_C(0x0000FFFF0000FFFF);
+    word = (word * 10000 + (word >> 32)) & UINT64_C(0x00000000FFFFFFFF);
+
+    return word;
+}
+
+static inline uint64_t swar_four_digits(uint64_t word)
+{
+    word -= SWAR_ONES(0x30) & UINT64_C(0xFFFFFFFF);
+    word = (word * 10 + (word >> 8)) & UINT64_C(0x00FF00FF);
+    word = (word * 100 + (word >> 16)) & UINT64_C(0x0000FFFF);
+
+    return word;
+}
+
 #define parse_signed(type, unsigned_type, value_type_min, value_type_max) \
     ParseNumError strnto## type(const char *nptr, const char * const end, char **endptr, type *ret) { \
         char c; \
-        char ***spp; \
+        char **sp, ***spp; \
         int negative; \
         int any, cutlim; \
         ParseNumError err; \
@@ -14,8 +60,6 @@
         negative = FALSE; \
         err = PARSE_NUM_NO_ERR; \
         if (NULL == endptr) { \
-            char **sp; \
- \
             sp = (char **) &nptr; \
             spp = &sp; \
         } else { \
@@ -81,7 +125,7 @@
 #define parse_unsigned(type, value_type_max) \
     ParseNumError strnto## type(const char *nptr, const char * const end, char **endptr, type *ret) { \
         char c; \
-        char ***spp; \
+        char **sp, ***spp; \
         int negative; \
         int any, cutlim; \
         type cutoff, acc; \
@@ -91,8 +135,6 @@
         negative = FALSE; \
         err = PARSE_NUM_NO_ERR; \
         if (NULL == endptr) { \
-            char **sp; \
- \
             sp = (char **) &nptr; \
             spp = &sp; \
         } else { \
@@ -111,6 +153,31 @@
             } \
             cutoff = value_type_max / 10; \
             cutlim = value_type_max % 10; \
+            /* 8, then 4, digits at a time, overflow being checked once per block */ \
+            if (sizeof(type) >= sizeof(uint32_t)) { \
+                uint64_t word; \
+ \
+                while (end - **spp >= 8 && swar_all_digits(word = swar_load(**spp, 8), ~UINT64_C(0))) { \
+                    word = swar_eight_digits(word); \
+                    if (any < 0 || acc > (value_type_max - word) / UINT64_C(100000000)) { \
+                        any = -1; \
+                    } else { \
+                        any = 1; \
+                        acc = acc * UINT64_C(100000000) + word; \
+                    } \
+                    **spp += 8; \
+                } \
+                if (end - **spp >= 4 && swar_all_digits(word = swar_load(**spp, 4), UINT64_C(0xFFFFFFFF))) { \
+                    word = swar_four_digits(word); \
+                    if (any < 0 || acc > (value_type_max - word) / 10000) { \
+                        any = -1; \
+                    } else { \
+                        any = 1; \
+                        acc = acc * 10000 + word; \
+                    } \
+                    **spp += 4; \
+                } \
+            } \
             while (**spp < end) { \
                 if (***spp >= '0' && ***spp <= '9') { \
                     c = ***spp - '0'; \
@@ -6,14 +6,26 @@
 // # include "utils/builtins.h"
 # include "utils/varbit.h"
 # include "utils/guc.h"
+# include "funcapi.h"
+# include "access/htup_details.h"
+# include "catalog/pg_type.h"
+# include "utils/array.h"
+# include "portability/instr_time.h"
 #else
 # include <stdio.h>
+# include <stdarg.h>
+# include <unistd.h>
 #endif /* POSTGRESQL */
 
 #include "common.h"
-#include "stack.h"
 #include "parsenum.h"
-#include "hashtable.h"
+#include "symtab.h"
+#include "program.h"
+#include "simplify.h"
+#include "match.h"
+#include "bdd.h"
+#include "cache.h"
+#include "sha256.h"
 
 #define I(x) (int)(x)
 
@@ -25,8 +37,26 @@ PG_MODULE_MAGIC;
 void _PG_init(void);
 PG_FUNCTION_INFO_V1(compile_query_int);
 Datum compile_query_int(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(compile_query_int_bdd);
+Datum compile_query_int_bdd(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(compile_query_int_digest);
+Datum compile_query_int_digest(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(query_int_cache_stats);
+Datum query_int_cache_stats(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(query_int_parser_stats);
+Datum query_int_parser_stats(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(query_int_parser_stats_reset);
+Datum query_int_parser_stats_reset(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(query_int_is_valid);
+Datum query_int_is_valid(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(query_int_count_symbols);
+Datum query_int_count_symbols(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(compiled_query_int_match);
+Datum compiled_query_int_match(PG_FUNCTION_ARGS);
 
 static int intarray_query_int_max_symbols;
+static int intarray_query_int_max_bdd_nodes;
+static int intarray_query_int_cache_size;
 /*static */int intarray_query_int_max_stack_size;
 #else
 # define POP(a, b) \
@@ -36,10 +66,24 @@ static int intarray_query_int_max_symbols;
 # define errcode(code) \
     /* NOP */
 # define errmsg(fmt, ...) \
-    fprintf(stderr, fmt "\n", ## __VA_ARGS__)
-#endif /* POSTGRESQL */
+    report_error(fmt, ## __VA_ARGS__)
+
+/* verbose: print trees and truth tables on stdout, quiet: only keep the last error in error_message */
+static bool verbose = TRUE, quiet = FALSE;
+static __thread char error_message[1024]; /* per thread for the bulk mode */
+
+static void report_error(const char *fmt, ...)
+{
+    va_list ap;
 
-typedef struct _QINode QINode;
+    va_start(ap, fmt);
+    vsnprintf(error_message, sizeof(error_message), fmt, ap);
+    va_end(ap);
+    if (!quiet) {
+        fprintf(stderr, "%s\n", error_message);
+    }
+}
+#endif /* POSTGRESQL */
 
 enum {
     ASSOC_NONE,
@@ -54,132 +98,208 @@ enum {
 };
 
 typedef enum {
-#define NODE(constant, name, characters, parsecb, evalcb) \
+#define NODE(constant, name, characters, parsecb, opcode) \
     constant,
-#define OPERATOR(constant, name, characters, parsecb, evalcb, associativity, precedence, arity) \
+#define OPERATOR(constant, name, characters, parsecb, opcode, associativity, precedence, arity) \
     constant,
 #include "nodes.h"
 #undef NODE
 #undef OPERATOR
 } QINodeType;
 
+#define SAT_UNKNOWN 2
+
 typedef struct {
-    QINode *root;
-    HashTable *symbols;
+    Arena *arena;
+    SymbolTable *symbols;
+    Program program;
+    uint8_t constant; /* 0 or 1 if the query is known to be always false or true (see detect_constant), SAT_UNKNOWN otherwise */
+    bool *relevant; /* by symbol identifier, NULL if all symbols are (see eliminate_vacuous) */
+    size_t relevant_count;
 } ParseResult;
 
-static int eval_or(QINode *, uint32_t i);
-#ifdef WITH_EXTRA_XOR
-static int eval_xor(QINode *, uint32_t i);
-#endif /* WITH_EXTRA_XOR */
-static int eval_not(QINode *, uint32_t i);
-static int eval_and(QINode *, uint32_t i);
-static int eval_int(QINode *, uint32_t i);
-static bool parse_int_symbol(HashTable *, QINode *, const char **, const char * const);
-static QINode *NEW_NODE(QINodeType, size_t);
-static bool parse(const char *, const char * const, ParseResult *);
-#ifndef NO_NEED_TO_FREE
-static void free_tree_node(QINode *);
-static void free_tree(QINode *);
-#endif /* !NO_NEED_TO_FREE */
-static int eval_tree(QINode *, uint32_t);
+static bool parse_int_symbol(const char **, const char * const, size_t, uint32_t *);
+static bool parse(Arena *, const char *, const char * const, ParseResult *);
 static void compile_start_states(void);
+static void choose_table_kernel(void);
 static char *allocate_buffer(void *, size_t);
 static uint8_t *compute_hash(void *, ParseResult *, uint8_t *, uint8_t *);
+#if defined(POSTGRESQL) || !defined(BENCHMARK)
+static uint8_t *compute_bdd(void *, ParseResult *, size_t, uint8_t *, uint8_t *);
+static uint8_t *compute_digest(void *, ParseResult *, uint8_t *, uint8_t *);
+#endif /* POSTGRESQL || !BENCHMARK */
 
 struct QINodeImplementation {
     const char *characters;
     const char *name;
-    int (*eval)(QINode *, uint32_t i);
-    bool (*parse)(HashTable *, QINode *, const char **, const char * const);
+    Opcode opcode;
+    bool (*parse)(const char **, const char * const, size_t, uint32_t *);
     int associativity;
     int precedence;
     int arity; // UNARY or BINARY
 } static available_nodes[] = {
-#define NODE(constant, name, characters, parsecb, evalcb) \
-    { characters, name, evalcb, parsecb, ASSOC_NONE, 0, NONE },
-#define OPERATOR(constant, name, characters, parsecb, evalcb, associativity, precedence, arity) \
-    { characters, name, evalcb, parsecb, associativity, precedence, arity },
+#define NODE(constant, name, characters, parsecb, opcode) \
+    { characters, name, opcode, parsecb, ASSOC_NONE, 0, NONE },
+#define OPERATOR(constant, name, characters, parsecb, opcode, associativity, precedence, arity) \
+    { characters, name, opcode, parsecb, associativity, precedence, arity },
 #include "nodes.h"
 #undef NODE
 #undef OPERATOR
 };
 
-struct _QINode {
-    QINodeType type;
-    QINode *left;
-    QINode *right;
-    size_t offset;
-    uint32_t *value;
-};
-
 static QINodeType assignments[256] = { 0 };
 
-static int eval_or(QINode *self, uint32_t i)
+/**
+ * Truth table is evaluated 64 rows (assignments) at a time: each symbol is
+ * turned into a word where the bit j is the value of this symbol for the
+ * row 64 * w + j. The 6 first symbols have a fixed pattern whatever the
+ * word, the others are constant (all 0 or all 1) for the whole word.
+ **/
+#define WORD_BIT 64
+#define WORD_ROWS_SHIFT 6
+
+static const uint64_t symbol_patterns[WORD_ROWS_SHIFT] = {
+    UINT64_C(0xAAAAAAAAAAAAAAAA),
+    UINT64_C(0xCCCCCCCCCCCCCCCC),
+    UINT64_C(0xF0F0F0F0F0F0F0F0),
+    UINT64_C(0xFF00FF00FF00FF00),
+    UINT64_C(0xFFFF0000FFFF0000),
+    UINT64_C(0xFFFFFFFF00000000),
+};
+
+static inline uint64_t symbol_word(uint32_t s, uint32_t w)
 {
-    return available_nodes[self->left->type].eval(self->left, i) || available_nodes[self->right->type].eval(self->right, i);
+    if (s < WORD_ROWS_SHIFT) {
+        return symbol_patterns[s];
+    } else {
+        return -(uint64_t) ((w >> (s - WORD_ROWS_SHIFT)) & 1);
+    }
 }
 
-#ifdef WITH_EXTRA_XOR
-static int eval_xor(QINode *self, uint32_t i)
+/**
+ * Runs of spaces (the only ignorable character, see nodes.h) and digits
+ * are scanned 16 characters at a time with SSE2: the characters of the
+ * class are found by a vector compare and the first one which isn't by
+ * the lowest bit unset of the mask of the results. The tail of the
+ * expression (and the whole of it without SSE2) is scanned one character
+ * at a time.
+ **/
+#ifdef __SSE2__
+# include <emmintrin.h>
+# define LEXER_VECTOR_SIZE 16
+
+static inline int lexer_first_unset(__m128i matches)
 {
-    return available_nodes[self->left->type].eval(self->left, i) ^ available_nodes[self->right->type].eval(self->right, i);
+    return __builtin_ctz(~_mm_movemask_epi8(matches) & 0xFFFF);
 }
-#endif /* WITH_EXTRA_XOR */
 
-static int eval_and(QINode *self, uint32_t i)
+static inline bool lexer_all_set(__m128i matches)
 {
-    return available_nodes[self->left->type].eval(self->left, i) && available_nodes[self->right->type].eval(self->right, i);
+    return 0xFFFF == _mm_movemask_epi8(matches);
 }
+#endif /* __SSE2__ */
 
-static int eval_not(QINode *self, uint32_t i)
+static inline const char *skip_spaces(const char *p, const char * const end)
 {
-    return !available_nodes[self->left->type].eval(self->left, i);
+#ifdef __SSE2__
+    const __m128i spaces = _mm_set1_epi8(' ');
+
+    for (/* NOP */; end - p >= LEXER_VECTOR_SIZE; p += LEXER_VECTOR_SIZE) {
+        __m128i matches;
+
+        matches = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p), spaces);
+        if (!lexer_all_set(matches)) {
+            return p + lexer_first_unset(matches);
+        }
+    }
+#endif /* __SSE2__ */
+    while (p < end && ' ' == *p) {
+        ++p;
+    }
+
+    return p;
 }
 
-static int eval_int(QINode *self, uint32_t i)
+static inline const char *skip_digits(const char *p, const char * const end)
 {
-    return i & *self->value;
-}
+#ifdef __SSE2__
+    /* signed compares: characters above 127 are negative, so not digits */
+    const __m128i below = _mm_set1_epi8('0' - 1), above = _mm_set1_epi8('9' + 1);
 
-static QINode *NEW_NODE(QINodeType type, size_t offset) {
-    QINode *n;
+    for (/* NOP */; end - p >= LEXER_VECTOR_SIZE; p += LEXER_VECTOR_SIZE) {
+        __m128i chunk, matches;
 
-    n = mem_new(*n);
-    n->type = type;
-    n->value = NULL;
-    n->offset = offset;
-    n->left = n->right = NULL;
+        chunk = _mm_loadu_si128((const __m128i *) p);
+        matches = _mm_and_si128(_mm_cmpgt_epi8(chunk, below), _mm_cmplt_epi8(chunk, above));
+        if (!lexer_all_set(matches)) {
+            return p + lexer_first_unset(matches);
+        }
+    }
+#endif /* __SSE2__ */
+    while (p < end && *p >= '0' && *p <= '9') {
+        ++p;
+    }
 
-    return n;
+    return p;
 }
 
-static bool parse_int_symbol(HashTable *symbols, QINode *node, const char **p, const char * const end)
+static bool parse_int_symbol(const char **p, const char * const end, size_t offset, uint32_t *value)
 {
     char *endptr;
-    uint32_t val;
     ParseNumError pne;
 
-    if (PARSE_NUM_NO_ERR != (pne = strntouint32_t(*p, end, &endptr, &val)) && (PARSE_NUM_ERR_NON_DIGIT_FOUND != pne)) {
+    /* the number is parsed to the end of its digits, which is known beforehand */
+    if (PARSE_NUM_NO_ERR != (pne = strntouint32_t(*p, skip_digits(*p, end), &endptr, value)) && (PARSE_NUM_ERR_NON_DIGIT_FOUND != pne)) {
         ereport(
             ERROR,
             (
                 errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                errmsg("invalid number at offset %" PRIszu, node->offset)
+                errmsg("invalid number at offset %" PRIszu, offset)
             )
         );
         return FALSE;
     }
-    debug("SYMBOL : >%.*s< (%" PRIu32 ")", I(endptr - *p), *p, val);
-    if (!hashtable_direct_get(symbols, (ht_hash_t) val, (void **) &node->value)) {
-        node->value = mem_new(*node->value);
-        hashtable_direct_put(symbols, (ht_hash_t) val, node->value, NULL);
-    }
+    debug("SYMBOL : >%.*s< (%" PRIu32 ")", I(endptr - *p), *p, *value);
     *p = endptr;
 
     return TRUE;
 }
 
+/**
+ * The expression is parsed in a single pass, by operator precedence, and
+ * the postfix program written as it is read: a symbol is emitted at once,
+ * an operator as soon as an operator of lower precedence (or equal, when
+ * left associative), a ')' or the end is met. Tokens alternate between an
+ * operand (a symbol, possibly preceded by '(' and unary operators) and an
+ * operator (a binary operator, possibly preceded by ')'), so only pending
+ * operators have to be kept.
+ **/
+typedef struct {
+    QINodeType type;
+    size_t offset;
+} PendingOperator;
+
+typedef struct {
+    /* buffers of the caller, for (end - expr) pending operators and (end - expr + 1) instructions */
+    PendingOperator *operators;
+    Instruction *code;
+    size_t pending, length, depth, max_depth;
+    size_t parentheses; /* opened and not yet closed */
+    SymbolTable *symbols;
+} Parser;
+
+#define PARSE_ERROR(...) \
+    do { \
+        ereport( \
+            ERROR, \
+            ( \
+                errcode(ERRCODE_INVALID_TEXT_REPRESENTATION), \
+                errmsg(__VA_ARGS__) \
+            ) \
+        ); \
+        return FALSE; \
+    } while (0)
+
 #ifdef POSTGRESQL
 # define STACK_OVERFLOW(stack) \
     do { \
@@ -190,313 +310,643 @@ static bool parse_int_symbol(HashTable *symbols, QINode *node, const char **p, c
                 errmsg("internal stack size " #stack " for parsing query_int exceeds the maximum allowed by 'intarray.query_int.max_stack_size' GUC (%d)", intarray_query_int_max_stack_size) \
             ) \
         ); \
-        goto end; \
-    } while (0);
-#else
-# define STACK_OVERFLOW(stack) /* NOP */
+        return FALSE; \
+    } while (0)
 #endif /* POSTGRESQL */
 
-#ifdef DEBUG
-# define PARSER_LINE_D \
-    const unsigned int __parser_line
-# define PARSER_LINE_DC \
-    PARSER_LINE_D,
-# define PARSER_LINE_C \
-    __LINE__
-# define PARSER_LINE_CC \
-    PARSER_LINE_C,
-#else
-# define PARSER_LINE_D  /* NOP */
-# define PARSER_LINE_DC /* NOP */
-# define PARSER_LINE_C  /* NOP */
-# define PARSER_LINE_CC /* NOP */
-#endif
-
-static bool handle_operator(PARSER_LINE_DC Stack *output, Stack *operators, QINode *node, QINode *op)
+static inline void parser_emit(Parser *parser, Opcode opcode, uint32_t operand)
 {
-    stack_pop(operators);
-    debug("POP(operators) %s (%d)", available_nodes[op->type].name, __parser_line);
-    if (stack_empty(output)) {
-        ereport(
-            ERROR,
-            (
-                errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                errmsg("invalid expression, lvalue expected before offset %" PRIszu, op->offset)
-            )
-        );
-#ifndef NO_NEED_TO_FREE
-        if (NULL != node) {
-            free(node);
-        }
-        free_tree_node(op);
-#endif /* !NO_NEED_TO_FREE */
-        goto end;
-    }
-    op->left = stack_pop(output);
-    debug("POP(output) %s (%d)", available_nodes[op->left->type].name, __parser_line);
-    if (available_nodes[op->type].arity > UNARY) {
-        if (stack_empty(output)) {
-            ereport(
-                ERROR,
-                (
-                    errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                    errmsg("invalid expression, rvalue expected after offset %" PRIszu, op->offset)
-                )
-            );
-#ifndef NO_NEED_TO_FREE
-            if (NULL != node) {
-                free(node);
+    parser->code[parser->length++] = INSTRUCTION(opcode, operand);
+    switch (opcode) {
+        case OP_PUSH:
+            if (++parser->depth > parser->max_depth) {
+                parser->max_depth = parser->depth;
             }
-            free_tree_node(op);
-#endif /* !NO_NEED_TO_FREE */
-            goto end;
-        }
-        op->right = stack_pop(output);
-        debug("POP(output) %s (%d)", available_nodes[op->right->type].name, __parser_line);
+            break;
+        case OP_AND:
+        case OP_OR:
+        case OP_XOR:
+            --parser->depth;
+            break;
+        default:
+            break;
     }
-    if (!stack_push(output, op)) {
-        STACK_OVERFLOW(output);
+}
+
+static inline bool parser_push(Parser *parser, QINodeType type, size_t offset)
+{
+#ifdef POSTGRESQL
+    if (parser->pending >= intarray_query_int_max_stack_size) {
+        STACK_OVERFLOW(operators);
     }
-    debug("PUSH(output) %s (%d)", available_nodes[op->type].name, __parser_line);
+#endif /* POSTGRESQL */
+    parser->operators[parser->pending].type = type;
+    parser->operators[parser->pending].offset = offset;
+    ++parser->pending;
 
     return TRUE;
-end:
-    return FALSE;
 }
 
-static bool parse(const char *expr, const char * const end, ParseResult *result)
+static inline void parser_pop(Parser *parser)
+{
+    --parser->pending;
+    debug("POP(operators) %s", available_nodes[parser->operators[parser->pending].type].name);
+    parser_emit(parser, available_nodes[parser->operators[parser->pending].type].opcode, 0);
+}
+
+/**
+ * Reports the missing operand before a binary operator or ')' at offset,
+ * or the end of the expression (type is then T_INVALID)
+ **/
+static bool parser_missing_operand(Parser *parser, QINodeType type, size_t offset)
+{
+    const PendingOperator *top;
+
+    top = 0 == parser->pending ? NULL : &parser->operators[parser->pending - 1];
+    if (NULL != top && T_LPAREN != top->type) { /* '1&)', '1&&2', '!' */
+        PARSE_ERROR("invalid expression, rvalue expected after offset %" PRIszu, top->offset);
+    } else if (T_INVALID != type && T_RPAREN != type) { /* '&1', '(|1)' */
+        PARSE_ERROR("invalid expression, lvalue expected before offset %" PRIszu, offset);
+    } else if (NULL != top && T_INVALID == type) { /* '1|(' */
+        PARSE_ERROR("invalid expression, parentheses mismatch for '(' at offset %" PRIszu, top->offset);
+    } else if (NULL == top && T_RPAREN == type) { /* ')' */
+        PARSE_ERROR("invalid expression, parentheses mismatch for ')' at offset %" PRIszu, offset);
+    } else { /* '' like '()' */
+        PARSE_ERROR("invalid expression, empty expression found");
+    }
+}
+
+static bool parse_query(Parser *parser, const char *expr, const char * const end)
 {
-    QINode *node;
     const char *p;
-    Stack *output, *operators;
+    bool operand; /* an operand is expected, else an operator */
 
-    result->root = NULL;
-#ifndef NO_NEED_TO_FREE
-    output = stack_new((DtorFunc) free_tree_node);
-    operators = stack_new((DtorFunc) free_tree_node);
-#else
-    output = stack_new(NULL);
-    operators = stack_new(NULL);
-#endif /* !NO_NEED_TO_FREE */
-    result->symbols = hashtable_new(NULL, uint32_cmp, NULL, NULL, free_func_name);
+    operand = TRUE;
     debug("EXPR is >%.*s<", I(end - expr), expr);
     for (p = expr; p < end; /* NOP */) {
         QINodeType type;
+        const struct QINodeImplementation *imp;
 
         type = assignments[(unsigned char) *p];
+        imp = &available_nodes[type];
+        if (T_IGNORABLES == type) {
+            /* the whole run is skipped at once */
+            p = skip_spaces(p + 1, end);
+            continue;
+        }
         if (!type) {
-            ereport(
-                ERROR,
-                (
-                    errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                    errmsg("invalid character '%c' at offset %ld\n\t%.*s\n\t%*c", *p, p - expr, I(end - expr), expr, I(p - expr + 1), '^')
-                )
-            );
-            goto end;
-        } else {
-            struct QINodeImplementation imp;
-
-            node = NEW_NODE(type, p - expr);
-            imp = available_nodes[type];
-            if (NULL == imp.parse) {
-                ++p;
-                if (type == T_LPAREN) {
-                    debug("(");
-                    if (!stack_push(operators, node)) {
-                        STACK_OVERFLOW(operators);
-                    }
-                    debug("PUSH(operators) %s (%d)", available_nodes[node->type].name, __LINE__);
-                } else if (type == T_RPAREN) {
-                    QINode *op;
-
-                    debug(")");
-                    op = NULL;
-                    while (
-                        !stack_empty(operators)
-                        && (op = stack_top(operators))
-                        && T_LPAREN != op->type
-                    ) {
-                        /**
-                         * Examples of possible errors:
-                         * - missing lvalue: '|)'
-                         * - missing rvalue: '3&)'
-                         **/
-                        if (!handle_operator(PARSER_LINE_CC output, operators, node, op)) {
-                            goto end;
-                        }
-                    }
-                    if (stack_empty(operators)) { /* '(1))&3+' */
-                        ereport(
-                            ERROR,
-                            (
-                                errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                                errmsg("invalid expression, parentheses mismatch for ')' at offset %" PRIszu, node->offset)
-                            )
-                        );
-#ifndef NO_NEED_TO_FREE
-                        free(node);
-                        if (NULL != op) {
-                            free_tree_node(op);
-                        }
-#endif /* !NO_NEED_TO_FREE */
-                        goto end;
-                    }
-                    /* op = */stack_pop(operators); /* '(' */
-                    debug("POP(output) %s (%d)", available_nodes[op->type].name, __LINE__);
-#ifndef NO_NEED_TO_FREE
-                    free(node); /* ')' */
-                    free(op);
-#endif /* !NO_NEED_TO_FREE */
-                }  else if (NULL != imp.eval) {
-                    QINode *op;
-
-                    debug("OPERATOR : %c", p[-1]);
-                    if (imp.arity > UNARY) {
-                        while (
-                            !stack_empty(operators)
-                            && (op = stack_top(operators))
-                            && (
-                                (ASSOC_LEFT == imp.associativity && imp.precedence <= available_nodes[op->type].precedence)
-                                ||
-                                (imp.precedence < available_nodes[op->type].precedence)
-                            )
-                        ) {
-                            /**
-                             * Examples of possible errors:
-                             * - missing lvalue: '&&'
-                             * - missing rvalue: '1&&'
-                             **/
-                            if (!handle_operator(PARSER_LINE_CC output, operators, node, op)) {
-                                goto end;
-                            }
-                        }
-                    }
-                    if (!stack_push(operators, node)) {
-                        STACK_OVERFLOW(operators);
-                    }
-                    debug("PUSH(operators) %s (%d)", available_nodes[node->type].name, __LINE__);
-                }
-#ifndef NO_NEED_TO_FREE
-                else {
-                    free(node); /* <ignorable> */
-                }
-#endif /* !NO_NEED_TO_FREE */
-            } else {
-                if (!imp.parse(result->symbols, node, &p, end)) { /* 99999999999999999999999999999 */
-                    fprintf(stderr, "invalid expression, failed to parse ...\n");
-#ifndef NO_NEED_TO_FREE
-                    free(node);
-#endif /* !NO_NEED_TO_FREE */
-                    goto end;
+            PARSE_ERROR("invalid character '%c' at offset %ld\n\t%.*s\n\t%*c", *p, p - expr, I(end - expr), expr, I(p - expr + 1), '^');
+        }
+        if (operand) {
+            if (NULL != imp->parse) {
+                uint32_t value;
+
+                if (!imp->parse(&p, end, p - expr, &value)) { /* 99999999999999999999999999999 */
+                    return FALSE;
                 }
-                if (!stack_push(output, node)) {
-                    STACK_OVERFLOW(output);
+                /* identifier of the symbol, until compute_hash or compute_bdd remaps it */
+                parser_emit(parser, OP_PUSH, symtab_intern(parser->symbols, value));
+                operand = FALSE;
+                continue;
+            }
+            if (T_LPAREN == type) {
+                ++parser->parentheses;
+            } else if (UNARY != imp->arity) {
+                return parser_missing_operand(parser, type, p - expr);
+            }
+            /* '(' and unary operators stay pending until their operand is complete */
+            if (!parser_push(parser, type, p - expr)) {
+                return FALSE;
+            }
+        } else if (T_RPAREN == type) {
+            if (0 == parser->parentheses) { /* '(1))&3' */
+                PARSE_ERROR("invalid expression, parentheses mismatch for ')' at offset %" PRIszu, (size_t) (p - expr));
+            }
+            --parser->parentheses;
+            while (T_LPAREN != parser->operators[parser->pending - 1].type) {
+                parser_pop(parser);
+            }
+            --parser->pending; /* '(' */
+        } else if (BINARY == imp->arity) {
+            debug("OPERATOR : %c", *p);
+            while (0 != parser->pending) {
+                int precedence;
+
+                precedence = available_nodes[parser->operators[parser->pending - 1].type].precedence;
+                if (imp->precedence < precedence || (ASSOC_LEFT == imp->associativity && imp->precedence == precedence)) {
+                    parser_pop(parser);
+                } else {
+                    break;
                 }
-                debug("PUSH(output) %s (%d)", available_nodes[node->type].name, __LINE__);
             }
+            if (!parser_push(parser, type, p - expr)) {
+                return FALSE;
+            }
+            operand = TRUE;
+        } else { /* '1 2', '1(2)', '1!2' */
+            PARSE_ERROR("invalid expression, remaining element found at offset %" PRIszu, (size_t) (p - expr));
         }
+        ++p;
     }
-    while (!stack_empty(operators)) {
-        QINode *op;
+    if (operand) {
+        return parser_missing_operand(parser, T_INVALID, p - expr);
+    }
+    while (0 != parser->pending) {
+        if (T_LPAREN == parser->operators[parser->pending - 1].type) { /* '(1|2' */
+            PARSE_ERROR("invalid expression, parentheses mismatch for '(' at offset %" PRIszu, parser->operators[parser->pending - 1].offset);
+        }
+        parser_pop(parser);
+    }
+#ifdef POSTGRESQL
+    if (parser->max_depth > intarray_query_int_max_stack_size) {
+        STACK_OVERFLOW(output);
+    }
+#endif /* POSTGRESQL */
+    parser->code[parser->length++] = INSTRUCTION(OP_END, 0);
 
-        op = stack_top(operators);
-        if (T_LPAREN == op->type) { /* '1|(' */
-            ereport(
-                ERROR,
-                (
-                    errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                    errmsg("invalid expression, parentheses mismatch for '(' at offset %" PRIszu, op->offset)
-                )
-            );
-            goto end;
-        } else {
-            /**
-             * Examples of possible errors:
-             * - missing lvalue: '1|(&3)'
-             * - missing rvalue: '(1|3)&(2)|'
-             **/
-            if (!handle_operator(PARSER_LINE_CC output, operators, NULL, op)) {
-                goto end;
+    return TRUE;
+}
+
+static bool parse(Arena *arena, const char *expr, const char * const end, ParseResult *result)
+{
+    bool parsed;
+    Parser parser;
+
+    /* pending operators and symbols are allocated from the arena, none of them is freed by the parser */
+    result->arena = arena;
+    result->constant = SAT_UNKNOWN;
+    result->relevant = NULL;
+    result->relevant_count = 0;
+    result->symbols = symtab_new(arena);
+    /* each token takes at least a character, hence the size of the buffers */
+    program_init(&result->program);
+    result->program.allocated = end - expr + 1;
+    result->program.code = mem_new_n(*result->program.code, result->program.allocated);
+    parser.operators = arena_mem_new_n(arena, *parser.operators, end - expr + 1);
+    parser.code = result->program.code;
+    parser.pending = parser.length = parser.depth = parser.max_depth = 0;
+    parser.parentheses = 0;
+    parser.symbols = result->symbols;
+    if ((parsed = parse_query(&parser, expr, end))) {
+        result->program.length = parser.length;
+        result->program.depth = parser.depth;
+        result->program.max_depth = parser.max_depth;
+        result->relevant_count = symtab_size(result->symbols);
+    }
+
+    return parsed;
+}
+
+#if defined(POSTGRESQL) || defined(BENCHMARK) /* callers of validate */
+/**
+ * Distinct symbols of an expression which is only validated, without any
+ * allocation: the first ones are searched linearly, then all of them are
+ * moved into an open addressing table (0, which can't be a symbol, marks
+ * an empty slot) of the stack.
+ **/
+#define SYMBOL_SET_LINEAR 16
+#define SYMBOL_SET_SHIFT 10
+#define SYMBOL_SET_SIZE (1 << SYMBOL_SET_SHIFT) /* slots */
+#define VALIDATE_MAX_SYMBOLS (SYMBOL_SET_SIZE / 2) /* the count stops there, far beyond the limits of the compile functions */
+
+typedef struct {
+    size_t count;
+    uint32_t linear[SYMBOL_SET_LINEAR];
+    uint32_t slots[SYMBOL_SET_SIZE];
+} SymbolSet;
+
+static bool symbol_set_insert(SymbolSet *set, uint32_t value)
+{
+    uint32_t i;
+
+    for (i = (value * UINT32_C(0x9E3779B1)) >> (32 - SYMBOL_SET_SHIFT); 0 != set->slots[i]; i = (i + 1) & (SYMBOL_SET_SIZE - 1)) {
+        if (value == set->slots[i]) {
+            return FALSE;
+        }
+    }
+    set->slots[i] = value;
+
+    return TRUE;
+}
+
+static void symbol_set_add(SymbolSet *set, uint32_t value)
+{
+    size_t i;
+
+    if (set->count < SYMBOL_SET_LINEAR) {
+        bool found;
+
+        /* unused entries are 0, which can't be a symbol, so all of them are compared, without any branch */
+        for (found = FALSE, i = 0; i < SYMBOL_SET_LINEAR; i++) {
+            found |= value == set->linear[i];
+        }
+        if (found) {
+            return;
+        }
+        set->linear[set->count++] = value;
+        if (SYMBOL_SET_LINEAR == set->count) {
+            memset(set->slots, 0, sizeof(set->slots));
+            for (i = 0; i < SYMBOL_SET_LINEAR; i++) {
+                symbol_set_insert(set, set->linear[i]);
             }
         }
+    } else if (set->count < VALIDATE_MAX_SYMBOLS && symbol_set_insert(set, value)) {
+        ++set->count;
+    }
+}
+#endif /* POSTGRESQL || BENCHMARK */
+
+/**
+ * Validation doesn't need the pending operators: but for the parentheses,
+ * which are only counted, the token which may follow another only depends
+ * on whether it is an operand (a digit or ')', after which a binary
+ * operator or ')' is expected) or not (a symbol, '(' or an unary operator
+ * is then expected). The expression is processed by blocks of 64
+ * characters: each character class is turned into a bitmask, the previous
+ * token of each token is found by an addition carrying through spaces and
+ * both are checked at once. Only symbols and parentheses are then visited,
+ * one by one.
+ **/
+#define VALIDATE_BLOCK_SIZE 64
+
+enum {
+    VALIDATE_INVALID, /* invalid character (or '0' at the start of a symbol, see VALIDATE_ZERO) */
+    VALIDATE_SPACE,
+    VALIDATE_ZERO,
+    VALIDATE_DIGIT,
+    VALIDATE_LPAREN,
+    VALIDATE_RPAREN,
+    VALIDATE_UNARY,
+    VALIDATE_BINARY,
+    _VALIDATE_CLASS_COUNT
+};
+
+static uint8_t validate_classes[256] = { VALIDATE_INVALID };
+
+/* non digit characters of the language, for them to be compared 16 at a time */
+static size_t validate_characters_count = 0;
+static struct {
+    char c;
+    uint8_t class;
+} validate_characters[256];
+
+static uint8_t validate_class(QINodeType type)
+{
+    if (T_IGNORABLES == type) {
+        return VALIDATE_SPACE;
+    } else if (T_LPAREN == type) {
+        return VALIDATE_LPAREN;
+    } else if (T_RPAREN == type) {
+        return VALIDATE_RPAREN;
+    } else if (NULL != available_nodes[type].parse) {
+        return VALIDATE_DIGIT;
+    } else if (UNARY == available_nodes[type].arity) {
+        return VALIDATE_UNARY;
+    } else if (BINARY == available_nodes[type].arity) {
+        return VALIDATE_BINARY;
+    } else {
+        return VALIDATE_INVALID;
+    }
+}
+
+static inline uint32_t lowest_bit64(uint64_t x)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(x);
+#else
+    uint32_t b;
+
+    for (b = 0; 0 == (x & 1); b++, x >>= 1)
+        ;
+
+    return b;
+#endif /* __GNUC__ */
+}
+
+static inline uint32_t bit_count64(uint64_t x)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(x);
+#else
+    uint32_t count;
+
+    for (count = 0; 0 != x; x &= x - 1) {
+        ++count;
+    }
+
+    return count;
+#endif /* __GNUC__ */
+}
+
+#if defined(POSTGRESQL) || defined(BENCHMARK) /* callers of validate */
+/* masks[class] gets the bit i set if the character i of block is of this class */
+static void validate_classify(const char *block, uint64_t *masks)
+{
+    int i;
+
+    memset(masks, 0, _VALIDATE_CLASS_COUNT * sizeof(*masks));
+#ifdef __SSE2__
+    for (i = 0; i < VALIDATE_BLOCK_SIZE; i += LEXER_VECTOR_SIZE) {
+        size_t c;
+        __m128i chunk, digits;
+
+        chunk = _mm_loadu_si128((const __m128i *) (block + i));
+        /* signed compares: characters above 127 are negative, so not digits (see skip_digits) */
+        digits = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0')), _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1)));
+        masks[VALIDATE_DIGIT] |= (uint64_t) _mm_movemask_epi8(digits) << i;
+        masks[VALIDATE_ZERO] |= (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('0'))) << i;
+        for (c = 0; c < validate_characters_count; c++) {
+            masks[validate_characters[c].class] |= (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(validate_characters[c].c))) << i;
+        }
     }
-    if (!stack_empty(output)) { /* '3 4' */
-        QINode *n;
+#else
+    for (i = 0; i < VALIDATE_BLOCK_SIZE; i++) {
+        masks[validate_classes[(unsigned char) block[i]]] |= UINT64_C(1) << i;
+    }
+#endif /* __SSE2__ */
+    masks[VALIDATE_INVALID] = ~(
+        masks[VALIDATE_SPACE] | masks[VALIDATE_ZERO] | masks[VALIDATE_DIGIT] | masks[VALIDATE_LPAREN]
+        | masks[VALIDATE_RPAREN] | masks[VALIDATE_UNARY] | masks[VALIDATE_BINARY]
+    );
+}
 
-        n = stack_pop(output);
-        debug("POP(output) %s (%d)", available_nodes[n->type].name, __LINE__);
-        if (stack_empty(output)) {
-            result->root = n;
+/**
+ * Checks the syntax of the expression [expr;end[ without allocating any
+ * memory nor reporting any error. If it is valid, returns TRUE and sets
+ * *symbols to its number of distinct symbols (up to VALIDATE_MAX_SYMBOLS),
+ * which isn't checked against any limit. An expression is valid if and
+ * only if parse accepts it (the limits of the stacks aside).
+ **/
+static bool validate(const char *expr, const char * const end, size_t *symbols)
+{
+    long depth;
+    SymbolSet set;
+    const char *p, *limit;
+    uint64_t after_operand, after_digit;
+    char last[VALIDATE_BLOCK_SIZE + 1]; /* the last block, padded with spaces (and a non digit) */
+
+    depth = 0;
+    set.count = 0;
+    memset(set.linear, 0, sizeof(set.linear));
+    after_operand = after_digit = 0;
+    for (p = expr; p < end; p += VALIDATE_BLOCK_SIZE) {
+        const char *block;
+        uint64_t masks[_VALIDATE_CLASS_COUNT], digits, starts, operands, tokens, sum, after, bits;
+
+        if (end - p >= VALIDATE_BLOCK_SIZE) {
+            block = p;
+            limit = end;
         } else {
-            ereport(
-                ERROR,
-                (
-                    errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                    errmsg("invalid expression, remaining element found at offset %" PRIszu, ((QINode *) stack_top(output))->offset)
-                )
-            );
-#ifndef NO_NEED_TO_FREE
-            free_tree_node(n);
-#endif /* !NO_NEED_TO_FREE */
-            goto end; /* not really useful */
+            memset(last, ' ', sizeof(last));
+            memcpy(last, p, end - p);
+            block = last;
+            limit = last + sizeof(last);
         }
-    } else { /* '' like '()' */
-        ereport(
-            ERROR,
-            (
-                errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                errmsg("invalid expression, empty expression found")
-            )
-        );
+        validate_classify(block, masks);
+        digits = masks[VALIDATE_ZERO] | masks[VALIDATE_DIGIT];
+        starts = digits & ~(digits << 1 | after_digit);
+        operands = digits | masks[VALIDATE_RPAREN];
+        tokens = ~masks[VALIDATE_SPACE];
+        /* the bit following an operand, carried through the spaces to the next token */
+        sum = (operands << 1 | after_operand) + masks[VALIDATE_SPACE];
+        after = sum & tokens;
+        if (
+            0 != masks[VALIDATE_INVALID]
+            || 0 != (starts & masks[VALIDATE_ZERO])
+            || 0 != (after & ~(masks[VALIDATE_BINARY] | masks[VALIDATE_RPAREN] | (digits & ~starts))) /* '1 2', '1(', '1!' */
+            || 0 != (tokens & ~after & ~(starts | masks[VALIDATE_LPAREN] | masks[VALIDATE_UNARY])) /* '&', '(&', '!)' */
+        ) {
+            return FALSE;
+        }
+        /* a carry out of the addition: spaces up to the end of the block after an operand */
+        after_operand = operands >> (VALIDATE_BLOCK_SIZE - 1) | (sum < masks[VALIDATE_SPACE]);
+        after_digit = digits >> (VALIDATE_BLOCK_SIZE - 1);
+        /* the depth can only become negative if there are enough ')' */
+        if (bit_count64(masks[VALIDATE_RPAREN]) > depth) {
+            for (bits = masks[VALIDATE_LPAREN] | masks[VALIDATE_RPAREN]; 0 != bits; bits &= bits - 1) {
+                if (0 != (masks[VALIDATE_LPAREN] & bits & -bits)) {
+                    ++depth;
+                } else if (--depth < 0) {
+                    return FALSE;
+                }
+            }
+        } else {
+            depth += (long) bit_count64(masks[VALIDATE_LPAREN]) - (long) bit_count64(masks[VALIDATE_RPAREN]);
+        }
+        for (bits = starts; 0 != bits; bits &= bits - 1) {
+            uint32_t b;
+            uint64_t value;
+            const char *q, *digits_end;
+
+            b = lowest_bit64(bits);
+            q = block + b;
+            /* the digits of a symbol may continue in the next block */
+            if (0 != (~digits >> b)) {
+                digits_end = q + lowest_bit64(~digits >> b);
+            } else {
+                digits_end = skip_digits(q, limit);
+            }
+            if ((size_t) (digits_end - q) > STR_LEN("4294967295")) {
+                return FALSE;
+            }
+            for (value = 0; q < digits_end; q++) {
+                value = value * 10 + (*q - '0');
+            }
+            if (value > UINT32_MAX) {
+                return FALSE;
+            }
+            symbol_set_add(&set, value);
+        }
+    }
+    if (0 == after_operand || 0 != depth) { /* '', '1&', '(1' */
+        return FALSE;
     }
+    *symbols = set.count;
 
-end:
-#ifndef NO_NEED_TO_FREE
-    stack_destroy(output);
-    stack_destroy(operators);
-#endif /* !NO_NEED_TO_FREE */
+    return TRUE;
+}
+#endif /* POSTGRESQL || BENCHMARK */
+
+/**
+ * DPLL-like search on the program of a query for a satisfying (or
+ * falsifying) assignment of its symbols, so a tautology or a contradiction
+ * is detected without generating any table, whatever its number of
+ * symbols. The program is run in three-valued logic on partial
+ * assignments and each decision assigns a symbol which leaves the result
+ * undetermined. The search stops at the first witness or after about
+ * SAT_MAX_WORK evaluated instructions (the answer is then unknown).
+ **/
+#define SAT_MAX_WORK (1 << 22) /* evaluated instructions */
+#define SAT_MIN_SYMBOLS 16 /* under which a table is as fast to generate */
+
+typedef struct {
+    const Program *program;
+    uint8_t *assignment;
+    /* frame, each value with a symbol which leaves it undetermined (if it is) */
+    uint8_t *values;
+    uint32_t *picks;
+    size_t budget;
+} SatSearch;
+
+static uint8_t sat_eval(SatSearch *search, uint32_t *pick)
+{
+    uint8_t *v;
+    uint32_t *s;
+    const Instruction *pc;
+
+    v = search->values;
+    s = search->picks;
+    for (pc = search->program->code; OP_END != OPCODE(*pc); pc++) {
+        switch (OPCODE(*pc)) {
+            case OP_PUSH:
+                *v++ = search->assignment[OPERAND(*pc)];
+                *s++ = OPERAND(*pc);
+                break;
+            case OP_NOT:
+                if (SAT_UNKNOWN != v[-1]) {
+                    v[-1] = !v[-1];
+                }
+                break;
+            case OP_AND:
+            case OP_OR:
+            {
+                uint8_t absorbing;
+
+                absorbing = OP_OR == OPCODE(*pc);
+                /* once popped, v[-1] is the left operand and v[0] the right one */
+                --v, --s;
+                if (absorbing == v[-1] || absorbing == v[0]) {
+                    v[-1] = absorbing;
+                } else if (SAT_UNKNOWN == v[0] && SAT_UNKNOWN != v[-1]) {
+                    v[-1] = SAT_UNKNOWN;
+                    s[-1] = s[0];
+                }
+                break;
+            }
+            case OP_XOR:
+                --v, --s;
+                if (SAT_UNKNOWN == v[0] && SAT_UNKNOWN != v[-1]) {
+                    v[-1] = SAT_UNKNOWN;
+                    s[-1] = s[0];
+                } else if (SAT_UNKNOWN != v[-1]) {
+                    v[-1] ^= v[0];
+                }
+                break;
+            case OP_LOAD:
+                *v++ = search->values[OPERAND(*pc)];
+                *s++ = search->picks[OPERAND(*pc)];
+                break;
+            case OP_STORE:
+                search->values[OPERAND(*pc)] = v[-1];
+                search->picks[OPERAND(*pc)] = s[-1];
+                break;
+            default:
+                assert(FALSE);
+                return SAT_UNKNOWN;
+        }
+    }
+    *pick = s[-1];
 
-    return NULL != result->root;
+    return v[-1];
 }
 
-#ifndef NO_NEED_TO_FREE
-static void free_tree_node(QINode *n)
+/**
+ * Returns 1 if an assignment for which the query is target was found,
+ * 0 if there is none, -1 if the budget of decisions is exhausted
+ **/
+static int sat_search(SatSearch *search, uint8_t target)
 {
-    if (NULL != n->left) {
-        free_tree_node(n->left);
+    int ret;
+    uint8_t v;
+    uint32_t pick;
+
+#ifdef POSTGRESQL
+    check_stack_depth();
+#endif /* POSTGRESQL */
+    if (target == (v = sat_eval(search, &pick))) {
+        return 1;
+    }
+    if (SAT_UNKNOWN != v) {
+        return 0;
+    }
+    if (0 == search->budget) {
+        return -1;
     }
-    if (NULL != n->right) {
-        free_tree_node(n->right);
+    --search->budget;
+    search->assignment[pick] = target;
+    if (0 == (ret = sat_search(search, target))) {
+        search->assignment[pick] = !target;
+        ret = sat_search(search, target);
     }
-    free(n);
+    search->assignment[pick] = SAT_UNKNOWN;
+
+    return ret;
 }
 
-static void free_tree(QINode *root)
+/**
+ * Rewrite the program of the query into a smaller equivalent one (see
+ * simplify.h), which may already show that it is constant
+ **/
+#define SIMPLIFY_MIN_SYMBOLS 12 /* under which the table costs less than the rewrite */
+
+static void simplify(ParseResult *result)
 {
-    assert(NULL != root);
+    int value;
 
-    free_tree_node(root);
+    if (symtab_size(result->symbols) < SIMPLIFY_MIN_SYMBOLS) {
+        return;
+    }
+    if (-1 != (value = program_simplify(&result->program, result->arena))) {
+        result->constant = value;
+    }
 }
-#endif /* !NO_NEED_TO_FREE */
 
-static int eval_tree(QINode *root, uint32_t i)
+/**
+ * Set result->constant to 1 (or 0) if the query is proven to always be
+ * true (or false)
+ **/
+static void detect_constant(ParseResult *result)
 {
-    assert(NULL != root);
+    int can_be_true;
+    SatSearch search;
 
-    return available_nodes[root->type].eval(root, i);
+    if (SAT_UNKNOWN != result->constant || symtab_size(result->symbols) < SAT_MIN_SYMBOLS) {
+        return;
+    }
+    search.program = &result->program;
+    search.assignment = arena_mem_new_n(result->arena, *search.assignment, symtab_size(result->symbols));
+    memset(search.assignment, SAT_UNKNOWN, symtab_size(result->symbols) * sizeof(*search.assignment));
+    search.values = arena_mem_new_n(result->arena, *search.values, result->program.max_depth + result->program.temporaries);
+    search.picks = arena_mem_new_n(result->arena, *search.picks, result->program.max_depth + result->program.temporaries);
+    /* each decision runs the whole program */
+    search.budget = MAX(SAT_MAX_WORK / result->program.length, 1);
+    if (0 == (can_be_true = sat_search(&search, TRUE))) {
+        result->constant = FALSE;
+    } else if (1 == can_be_true && 0 == sat_search(&search, FALSE)) {
+        result->constant = TRUE;
+    }
 }
 
 static void compile_start_states(void)
 {
     int i;
 
+    choose_table_kernel();
     for (i = 0; i < ARRAY_SIZE(available_nodes); i++) {
         const char *p;
 
         for (p = available_nodes[i].characters; '\0' != *p; p++) {
             assignments[(unsigned char) *p] = i;
+            validate_classes[(unsigned char) *p] = validate_class(i);
+            if (NULL == available_nodes[i].parse && VALIDATE_INVALID != validate_classes[(unsigned char) *p]) {
+                validate_characters[validate_characters_count].c = *p;
+                validate_characters[validate_characters_count].class = validate_classes[(unsigned char) *p];
+                ++validate_characters_count;
+            }
         }
     }
+    /* '0' can't start a symbol but can follow its first digit */
+    validate_classes['0'] = VALIDATE_ZERO;
 }
 
 #define GETBIT_AT(var, pos) \
@@ -523,72 +973,965 @@ static void compile_start_states(void)
 #define BYTE_LENGTH(nb) \
     ((nb + CHAR_BIT - 1) / CHAR_BIT)
 
-#include "hashtable-int.h"
 
-static uint8_t *compute_hash(void *parent, ParseResult *result, uint8_t *all_true, uint8_t *all_false)
+/**
+ * Rows of a word are stored, 8 by 8, in consecutive bytes of the output
+ * where row r of a byte is its bit (r + 4) % 8 (see BITMASK), that is
+ * a swap of the 2 nibbles.
+ **/
+#define NIBBLE_SWAP(byte) \
+    ((uint8_t) (((byte) << 4) | ((byte) >> 4)))
+
+static inline void store_word(uint8_t *h, size_t offset, size_t len, uint64_t word)
 {
-    int s, b;
-    uint8_t *h;
-    HashNode *n;
-    uint32_t i, l;
-    size_t h_size, h_len;
+    size_t k;
 
-    h_len = 0;
-    *all_false = *all_true = TRUE;
-    h_size = sizeof(uint32_t) + hashtable_size(result->symbols) * sizeof(uint32_t) + BYTE_LENGTH((1U << hashtable_size(result->symbols)));
-    h = (uint8_t *) allocate_buffer(parent, h_size);
-    WRITE_UINT32(h, h_len, hashtable_size(result->symbols));
-    //for (s = 0, n = result->symbols->gHead; NULL != n; n = n->gNext, s++) {
-    for (s = 0, n = result->symbols->gTail; NULL != n; n = n->gPrev, s++) {
-        *((uint32_t *) n->data) = 1U << s;
+    for (k = 0; k < len; k++, word >>= CHAR_BIT) {
+        h[offset + k] = NIBBLE_SWAP((uint8_t) word);
     }
-    for (n = result->symbols->gHead; NULL != n; n = n->gNext) {
-        WRITE_UINT32(h, h_len, n->hash);
-#ifdef MAXIMAL_OUTPUT
-        printf(" %4d "/*"(0x%X)"*/, n->hash/*, *((uint32_t *) n->data)*/);
-#endif /* MAXIMAL_OUTPUT */
+}
+
+/**
+ * The program is interpreted with a computed goto by instruction when the
+ * compiler supports it (GCC, clang), through a switch in a loop otherwise.
+ * Each instruction has to be introduced by VM_CASE and ended by VM_NEXT.
+ **/
+#ifdef __GNUC__
+# define VM_DISPATCH_TABLE \
+    static const void *dispatch[_OP_COUNT] = { \
+        [OP_END] = &&vm_OP_END, \
+        [OP_PUSH] = &&vm_OP_PUSH, \
+        [OP_NOT] = &&vm_OP_NOT, \
+        [OP_AND] = &&vm_OP_AND, \
+        [OP_OR] = &&vm_OP_OR, \
+        [OP_XOR] = &&vm_OP_XOR, \
+        [OP_LOAD] = &&vm_OP_LOAD, \
+        [OP_STORE] = &&vm_OP_STORE, \
     }
-#ifdef MAXIMAL_OUTPUT
-    printf(" | Result ");
-    printf("\n");
-#endif /* MAXIMAL_OUTPUT */
-    for (i = 0, l = 1U << hashtable_size(result->symbols); i < l; i++) {
-#ifdef MAXIMAL_OUTPUT
-        for (s = 0, n = result->symbols->gHead; NULL != n; n = n->gNext, s++) {
-            printf(" %4d ", !!(i & *((uint32_t *) n->data))/*GETBIT_AT(i, s)*/);
-        }
-#endif /* MAXIMAL_OUTPUT */
-        if ((b = eval_tree(result->root, i))) {
-            SETBIT_AT(h, h_len, i);
+# define VM_CASE(opcode) \
+    case opcode: vm_ ## opcode:
+# define VM_NEXT() \
+    goto *dispatch[OPCODE(*pc)]
+#else
+# define VM_DISPATCH_TABLE \
+    /* NOP */
+# define VM_CASE(opcode) \
+    case opcode:
+# define VM_NEXT() \
+    continue
+#endif /* __GNUC__ */
+
+static uint64_t run_program(const Instruction *pc, uint64_t *sp, uint32_t w)
+{
+    uint64_t *frame;
+    VM_DISPATCH_TABLE;
+
+    frame = sp;
+    for (;;) {
+        switch (OPCODE(*pc)) {
+            VM_CASE(OP_PUSH)
+                *sp++ = symbol_word(OPERAND(*pc), w);
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_NOT)
+                sp[-1] = ~sp[-1];
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_AND)
+                --sp;
+                sp[-1] &= *sp;
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_OR)
+                --sp;
+                sp[-1] |= *sp;
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_XOR)
+                --sp;
+                sp[-1] ^= *sp;
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_LOAD)
+                *sp++ = frame[OPERAND(*pc)];
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_STORE)
+                frame[OPERAND(*pc)] = sp[-1];
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_END)
+            default:
+                return sp[-1];
         }
-        *all_true &= b;
-        *all_false &= ~b;
+    }
+}
+
+/**
+ * A kernel fills the words [first;last[ of a table, t being the address
+ * of the word first (not of the table), so a table can also be generated
+ * piece by piece in a smaller buffer.
+ **/
+typedef void (*TableKernel)(const Instruction *, void *, uint8_t *, uint32_t, uint32_t, uint64_t, size_t, uint8_t *, uint8_t *);
+
+static void fill_table_scalar(const Instruction *code, void *stack, uint8_t *t, uint32_t first, uint32_t last, uint64_t mask, size_t word_len, uint8_t *all_true, uint8_t *all_false)
+{
+    uint32_t w;
+    uint64_t word;
+
+    for (w = first; w < last; w++) {
+        word = run_program(code, (uint64_t *) stack, w) & mask;
+        store_word(t, (w - first) * word_len, word_len, word);
+        *all_true &= word == mask;
+        *all_false &= 0 == word;
+    }
+}
+
+/**
+ * Incremental evaluation of the program, word after word in Gray code
+ * order: from a word to the next one, a single symbol among those outside
+ * of a word (bits 6 and above of a row) changes, so only the instructions
+ * depending on it are evaluated again, the value of each instruction for
+ * the previous word being kept. Words are still written at their natural
+ * place in the table. For a wide but shallow query, like a disjunction of
+ * many conjunctions, the cost of a word is then proportional to the depth
+ * of the symbol which changed instead of the length of the program.
+ * SIMD kernels do the same with vectors of consecutive words, walked in
+ * Gray code order. This is used instead of fill_table when it is expected
+ * to evaluate at least GRAY_MIN_GAIN times less instructions.
+ **/
+#define GRAY_MIN_WORDS 64
+#define GRAY_MIN_GAIN 2
+
+typedef struct {
+    uint32_t opcode;
+    uint32_t left;  /* symbol for OP_PUSH, (index of the) operand of OP_NOT, OP_LOAD and OP_STORE, left operand otherwise */
+    uint32_t right; /* right operand of a binary operator */
+} GrayInstruction;
+
+typedef struct {
+    size_t length; /* number of instructions (OP_END excluded), the last one being the root */
+    GrayInstruction *code;
+    /**
+     * instructions depending on the symbol of bit 6 + b of the rows, by
+     * ascending index (so operands are evaluated first), are the ones of
+     * dependents[offsets[b]] to dependents[offsets[b + 1] - 1]
+     **/
+    uint32_t *offsets;
+    uint32_t *dependents;
+} GrayPlan;
+
+static inline uint32_t lowest_bit(uint32_t x)
+{
+#ifdef __GNUC__
+    return __builtin_ctz(x);
+#else
+    uint32_t b;
+
+    for (b = 0; 0 == (x & 1); b++, x >>= 1)
+        ;
+
+    return b;
+#endif /* __GNUC__ */
+}
+
+static inline uint64_t gray_eval(const GrayInstruction *instruction, const uint64_t *values, uint32_t w)
+{
+    switch (instruction->opcode) {
+        case OP_PUSH:
+            return symbol_word(instruction->left, w);
+        case OP_NOT:
+            return ~values[instruction->left];
+        case OP_LOAD:
+        case OP_STORE:
+            return values[instruction->left];
+        case OP_AND:
+            return values[instruction->left] & values[instruction->right];
+        case OP_OR:
+            return values[instruction->left] | values[instruction->right];
+        case OP_XOR:
+        default:
+            return values[instruction->left] ^ values[instruction->right];
+    }
+}
+
+/**
+ * Same as a TableKernel but from a plan (see gray_plan_new), the stack
+ * being the values of its instructions. The range is walked by blocks of
+ * 2^k words aligned on 2^k, the first word of a block being entirely
+ * evaluated.
+ **/
+typedef void (*GrayKernel)(const GrayPlan *, void *, uint8_t *, uint32_t, uint32_t, uint64_t, size_t, uint8_t *, uint8_t *);
+
+static void fill_table_gray_scalar(const GrayPlan *plan, void *stack, uint8_t *t, uint32_t first, uint32_t last, uint64_t mask, size_t word_len, uint8_t *all_true, uint8_t *all_false)
+{
+    size_t i;
+    uint64_t word, *values;
+    uint32_t base, size, step, w, b;
+
+    values = (uint64_t *) stack;
+    for (base = first; base < last; base += size) {
+        for (size = 1; 0 == (base & size) && base + 2 * size <= last; size *= 2)
+            ;
+        w = base;
+        for (i = 0; i < plan->length; i++) {
+            values[i] = gray_eval(&plan->code[i], values, w);
+        }
+        for (step = 0; step < size; step++) {
+            if (0 != step) {
+                /* the Gray codes of step - 1 and step only differ by the lowest bit set in step */
+                b = lowest_bit(step);
+                w ^= UINT32_C(1) << b;
+                for (i = plan->offsets[b]; i < plan->offsets[b + 1]; i++) {
+                    values[plan->dependents[i]] = gray_eval(&plan->code[plan->dependents[i]], values, w);
+                }
+            }
+            word = values[plan->length - 1] & mask;
+            store_word(t, (size_t) (w - first) * word_len, word_len, word);
+            *all_true &= word == mask;
+            *all_false &= 0 == word;
+        }
+    }
+}
+
+/**
+ * SIMD kernels evaluate 4 (AVX2) or 8 (AVX-512) words, so 256 or 512 rows,
+ * at once. They are built whatever the compiler flags and the right one is
+ * chosen at runtime (see compile_start_states) according to the CPU.
+ **/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define WITH_SIMD_KERNELS
+# define KERNEL_NAME avx2
+# define KERNEL_TARGET "avx2"
+# define KERNEL_LANES 4
+# define KERNEL_LANES_SHIFT 2
+# include "table_kernel.h"
+# undef KERNEL_LANES_SHIFT
+# undef KERNEL_LANES
+# undef KERNEL_TARGET
+# undef KERNEL_NAME
+# define KERNEL_NAME avx512
+# define KERNEL_TARGET "avx512f"
+# define KERNEL_LANES 8
+# define KERNEL_LANES_SHIFT 3
+# include "table_kernel.h"
+# undef KERNEL_LANES_SHIFT
+# undef KERNEL_LANES
+# undef KERNEL_TARGET
+# undef KERNEL_NAME
+#endif /* __GNUC__ && x86 */
+
+#define VALUE_STACK_ALIGNMENT 64 /* sizeof of the widest vector (AVX-512) */
+
+static TableKernel fill_table = fill_table_scalar;
+static GrayKernel fill_table_gray = fill_table_gray_scalar;
+static uint32_t table_kernel_shift = 0; /* fill_table evaluates 2^table_kernel_shift words at once */
+
+/**
+ * Returns the plan to fill a table of wl words, NULL if fill_table is
+ * expected to be as fast
+ **/
+static GrayPlan *gray_plan_new(Arena *arena, const Program *program, uint32_t wl)
+{
+    GrayPlan *plan;
+    size_t i, n, top;
+    uint32_t b, hs, *stack, *symbols, *slots;
+    double evaluations;
+
+    if (wl < GRAY_MIN_WORDS) {
+        return NULL;
+    }
+    for (hs = 0; (UINT32_C(1) << hs) < wl; hs++)
+        ;
+    n = program->length - 1;
+    plan = arena_mem_new(arena, *plan);
+    plan->length = n;
+    plan->code = arena_mem_new_n(arena, *plan->code, n);
+    /* symbols outside of a word each instruction depends on, bit b for the symbol of bit 6 + b of the rows */
+    symbols = arena_mem_new_n(arena, *symbols, n);
+    stack = arena_mem_new_n(arena, *stack, program->max_depth + 1);
+    slots = arena_mem_new_n(arena, *slots, program->max_depth + program->temporaries);
+    for (i = top = 0; i < n; i++) {
+        plan->code[i].opcode = OPCODE(program->code[i]);
+        switch (OPCODE(program->code[i])) {
+            case OP_PUSH:
+                plan->code[i].left = OPERAND(program->code[i]);
+                symbols[i] = plan->code[i].left < WORD_ROWS_SHIFT ? 0 : UINT32_C(1) << (plan->code[i].left - WORD_ROWS_SHIFT);
+                stack[top++] = i;
+                break;
+            case OP_NOT:
+                plan->code[i].left = stack[top - 1];
+                symbols[i] = symbols[stack[top - 1]];
+                stack[top - 1] = i;
+                break;
+            /**
+             * a temporary is the instruction which computed it: these
+             * ones are only evaluated with the first word of a block (as
+             * a copy, which is never used)
+             **/
+            case OP_STORE:
+                plan->code[i].left = slots[OPERAND(program->code[i])] = stack[top - 1];
+                symbols[i] = 0;
+                break;
+            case OP_LOAD:
+                plan->code[i].left = stack[top++] = slots[OPERAND(program->code[i])];
+                symbols[i] = 0;
+                break;
+            default:
+                plan->code[i].left = stack[top - 2];
+                plan->code[i].right = stack[top - 1];
+                symbols[i] = symbols[stack[top - 2]] | symbols[stack[top - 1]];
+                stack[--top - 1] = i;
+                break;
+        }
+    }
+    /* the root, whose value is the word, is never a temporary */
+    assert(OP_LOAD != plan->code[n - 1].opcode && OP_STORE != plan->code[n - 1].opcode);
+    plan->offsets = arena_mem_new_n(arena, *plan->offsets, hs + 1);
+    memset(plan->offsets, 0, (hs + 1) * sizeof(*plan->offsets));
+    for (i = 0; i < n; i++) {
+        for (b = 0; b < hs; b++) {
+            plan->offsets[b + 1] += (symbols[i] >> b) & 1;
+        }
+    }
+    /**
+     * the symbol of bit 6 + b changes every 2^(b + 1) words, so every
+     * 2^(b + 1 - table_kernel_shift) vectors of words for the symbols
+     * which aren't the same for all the words of a vector
+     **/
+    evaluations = 0;
+    for (b = 0; b < hs; b++) {
+        if (b >= table_kernel_shift) {
+            evaluations += plan->offsets[b + 1] / (double) (UINT64_C(1) << (b + 1 - table_kernel_shift));
+        }
+        plan->offsets[b + 1] += plan->offsets[b];
+    }
+    if (GRAY_MIN_GAIN * evaluations > n) {
+        return NULL;
+    }
+    plan->dependents = arena_mem_new_n(arena, *plan->dependents, plan->offsets[hs]);
+    for (b = 0; b < hs; b++) {
+        uint32_t d;
+
+        d = plan->offsets[b];
+        for (i = 0; i < n; i++) {
+            if (0 != ((symbols[i] >> b) & 1)) {
+                plan->dependents[d++] = i;
+            }
+        }
+    }
+
+    return plan;
+}
+
+
+#define ALIGNED_VALUE_STACK(stack) \
+    ((void *) (((uintptr_t) (stack) + VALUE_STACK_ALIGNMENT - 1) & ~((uintptr_t) VALUE_STACK_ALIGNMENT - 1)))
+
+#ifndef POSTGRESQL
+# include <pthread.h>
+
+/**
+ * In standalone, large tables are split between table_threads threads,
+ * each one filling its own range of words, on a cache line boundary
+ * (from the start of the table) to not share one.
+ **/
+# define CACHE_LINE_WORDS (64 / sizeof(uint64_t))
+# define MIN_WORDS_BY_THREAD 4096
+
+static long table_threads = 1;
+
+typedef struct {
+    const Instruction *code;
+    const GrayPlan *gray;
+    uint8_t *stack;
+    uint8_t *t;
+    uint32_t first;
+    uint32_t last;
+    uint64_t mask;
+    size_t word_len;
+    uint8_t all_true;
+    uint8_t all_false;
+    pthread_t tid;
+    bool started;
+} TableJob;
+
+static void *table_worker(void *arg)
+{
+    TableJob *job;
+
+    job = (TableJob *) arg;
+    job->all_true = job->all_false = TRUE;
+    if (NULL == job->gray) {
+        fill_table(job->code, ALIGNED_VALUE_STACK(job->stack), job->t, job->first, job->last, job->mask, job->word_len, &job->all_true, &job->all_false);
+    } else {
+        fill_table_gray(job->gray, ALIGNED_VALUE_STACK(job->stack), job->t, job->first, job->last, job->mask, job->word_len, &job->all_true, &job->all_false);
+    }
+
+    return NULL;
+}
+#endif /* !POSTGRESQL */
+
+static void run_table_kernel(Arena *arena, const Program *program, uint8_t *t, uint32_t wl, uint64_t mask, size_t word_len, uint8_t *all_true, uint8_t *all_false)
+{
+    uint8_t *stack;
+    size_t stack_size;
+    GrayPlan *gray;
+
+    /* frame, aligned for the widest kernel, or the values of the instructions */
+    stack_size = (program->max_depth + program->temporaries + 1) * VALUE_STACK_ALIGNMENT;
+    if (NULL != (gray = gray_plan_new(arena, program, wl))) {
+        stack_size = MAX(stack_size, (gray->length + 1) * VALUE_STACK_ALIGNMENT);
+    }
+#ifndef POSTGRESQL
+    if (table_threads > 1 && wl >= 2 * MIN_WORDS_BY_THREAD) {
+        long i, threads;
+        TableJob *jobs;
+        uint32_t chunk, skew;
+
+        threads = MIN(table_threads, (long) (wl / MIN_WORDS_BY_THREAD));
+        chunk = ((wl / threads + CACHE_LINE_WORDS - 1) / CACHE_LINE_WORDS) * CACHE_LINE_WORDS;
+        /*
+         * the ranges start on a cache line of the buffer (or 4 bytes after
+         * it, the table following the symbols), not of the table, for two
+         * threads not to write the same line
+         */
+        skew = (uint32_t) ((uintptr_t) t / word_len % CACHE_LINE_WORDS);
+        jobs = mem_new_n(*jobs, threads);
+        for (i = 0; i < threads; i++) {
+            jobs[i].code = program->code;
+            jobs[i].gray = gray;
+            jobs[i].stack = mem_new_n(*jobs[i].stack, stack_size);
+            jobs[i].first = 0 == i ? 0 : jobs[i - 1].last;
+            jobs[i].t = t + (size_t) jobs[i].first * word_len;
+            /* chunk * threads can be less than wl (by up to threads - 1 words) */
+            jobs[i].last = threads - 1 == i ? wl : MIN(wl, (uint32_t) (i + 1) * chunk - skew);
+            jobs[i].mask = mask;
+            jobs[i].word_len = word_len;
+            /* the first range is for the current thread */
+            jobs[i].started = 0 != i && 0 == pthread_create(&jobs[i].tid, NULL, table_worker, &jobs[i]);
+        }
+        table_worker(&jobs[0]);
+        for (i = 0; i < threads; i++) {
+            if (jobs[i].started) {
+                pthread_join(jobs[i].tid, NULL);
+            } else if (0 != i) {
+                /* thread creation failed, fill the range ourself */
+                table_worker(&jobs[i]);
+            }
+            *all_true &= jobs[i].all_true;
+            *all_false &= jobs[i].all_false;
+            free(jobs[i].stack);
+        }
+        free(jobs);
+    } else
+#endif /* !POSTGRESQL */
+    {
+        stack = mem_new_n(*stack, stack_size);
+        if (NULL == gray) {
+            fill_table(program->code, ALIGNED_VALUE_STACK(stack), t, 0, wl, mask, word_len, all_true, all_false);
+        } else {
+            fill_table_gray(gray, ALIGNED_VALUE_STACK(stack), t, 0, wl, mask, word_len, all_true, all_false);
+        }
+#ifndef NO_NEED_TO_FREE
+        free(stack);
+#endif /* !NO_NEED_TO_FREE */
+    }
+}
+
+static void choose_table_kernel(void)
+{
+#ifdef WITH_SIMD_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        fill_table = fill_table_avx512;
+        fill_table_gray = fill_table_gray_avx512;
+        table_kernel_shift = 3;
+        debug("using AVX-512 truth table kernel");
+    } else if (__builtin_cpu_supports("avx2")) {
+        fill_table = fill_table_avx2;
+        fill_table_gray = fill_table_gray_avx2;
+        table_kernel_shift = 2;
+        debug("using AVX2 truth table kernel");
+    } else
+#endif /* WITH_SIMD_KERNELS */
+    {
+        fill_table = fill_table_scalar;
+        fill_table_gray = fill_table_gray_scalar;
+        table_kernel_shift = 0;
+        debug("using scalar truth table kernel");
+    }
+}
+
+/**
+ * Detection of the symbols which have no influence on the result, like 2
+ * in '1 & (2 | !2)' or 7 in '3 | (3 & 7)', so they can be left out of the
+ * output (and of the table): for each symbol, are both cofactors equal?
+ * The support of the BDD of the query answers it for all symbols at once.
+ * When the BDD is too large, or the table small, the rows of the table
+ * are compared pairwise (a row with the one where the symbol is set),
+ * stopping at the first difference for the symbols outside of a word.
+ * This scan being exponential, it is not done for more than max_symbols
+ * symbols: they are all kept, for the caller to reject the query.
+ **/
+#define VACUOUS_SCAN_SYMBOLS 12 /* up to which the table is small enough to be scanned */
+#define VACUOUS_MAX_BDD_NODES (1 << 16)
+
+/**
+ * A small table (up to VACUOUS_SCAN_SYMBOLS symbols) is evaluated once in
+ * words, a larger one, word by word as needed
+ **/
+static inline uint64_t scan_word(const Program *program, uint64_t *stack, const uint64_t *words, uint32_t w, uint64_t mask)
+{
+    return NULL == words ? run_program(program->code, stack, w) & mask : words[w];
+}
+
+/**
+ * Set relevant[b] if the symbol of bit b of the rows has an influence on
+ * the result (program's operands being these bits) and constant to the
+ * value of the first row
+ **/
+static void scan_vacuous(Arena *arena, const Program *program, size_t ns, bool *relevant, uint8_t *constant)
+{
+    size_t b;
+    uint64_t mask, word, first;
+    uint32_t w, wl, l;
+    uint64_t *stack, *words;
+
+    stack = arena_mem_new_n(arena, *stack, program->max_depth + program->temporaries + 1);
+    l = 1U << ns;
+    if (l < WORD_BIT) {
+        wl = 1;
+        mask = (UINT64_C(1) << l) - 1;
+    } else {
+        wl = l / WORD_BIT;
+        mask = ~UINT64_C(0);
+    }
+    words = NULL;
+    if (ns <= VACUOUS_SCAN_SYMBOLS) {
+        words = arena_mem_new_n(arena, *words, wl);
+        for (w = 0; w < wl; w++) {
+            words[w] = run_program(program->code, stack, w) & mask;
+        }
+    }
+    first = scan_word(program, stack, words, 0, mask);
+    /* symbols inside a word: compare the row r with r + 2^b, for all words */
+    for (w = 0; w < wl; w++) {
+        bool pending;
+
+        word = scan_word(program, stack, words, w, mask);
+        pending = FALSE;
+        for (b = 0; b < MIN(ns, WORD_ROWS_SHIFT); b++) {
+            relevant[b] |= 0 != (((word >> (1U << b)) ^ word) & ~symbol_patterns[b] & mask);
+            pending |= !relevant[b];
+        }
+        if (!pending) {
+            break;
+        }
+    }
+    /* symbols outside of a word: compare the word w with w + 2^(b - 6) */
+    for (b = WORD_ROWS_SHIFT; b < ns; b++) {
+        uint32_t bit;
+
+        bit = 1U << (b - WORD_ROWS_SHIFT);
+        for (w = 0; w < wl && !relevant[b]; w++) {
+            if (0 == (w & bit)) {
+                relevant[b] = scan_word(program, stack, words, w, mask) != scan_word(program, stack, words, w | bit, mask);
+            }
+        }
+    }
+    *constant = 0 == first ? FALSE : TRUE;
+}
+
+static void eliminate_vacuous(ParseResult *result, size_t max_symbols)
+{
+    BDD *bdd;
+    BDDRef root;
+    size_t i, s, ns, nr;
+    Program program;
+    const uint32_t *ranks;
+    bool done, *relevant_by_rank;
+    uint8_t constant;
+
+    ns = symtab_size(result->symbols);
+    if (SAT_UNKNOWN != result->constant) {
+        return;
+    }
+    symtab_sort(result->symbols);
+    ranks = symtab_ranks(result->symbols);
+    relevant_by_rank = arena_mem_new_n(result->arena, *relevant_by_rank, ns);
+    memset(relevant_by_rank, 0, ns * sizeof(*relevant_by_rank));
+    /* work on a copy of the program where symbols are numbered by rank */
+    program = result->program;
+    program.code = arena_mem_new_n(result->arena, *program.code, program.length);
+    for (i = 0; i < program.length; i++) {
+        if (OP_PUSH == OPCODE(result->program.code[i])) {
+            program.code[i] = INSTRUCTION(OP_PUSH, ranks[OPERAND(result->program.code[i])]);
+        } else {
+            program.code[i] = result->program.code[i];
+        }
+    }
+    done = FALSE;
+    constant = SAT_UNKNOWN;
+    if (ns > VACUOUS_SCAN_SYMBOLS) {
+        bdd = bdd_new(ns, VACUOUS_MAX_BDD_NODES);
+        if ((done = bdd_build(bdd, &program, &root))) {
+            if (BDD_IS_TERMINAL(root)) {
+                constant = BDD_TRUE == root;
+            } else {
+                bdd_support(bdd, root, relevant_by_rank);
+            }
+        }
+        bdd_destroy(bdd);
+    }
+    if (!done) {
+        if (ns > max_symbols) {
+            /* too many symbols to scan the table (which won't be generated anyway) */
+            return;
+        }
+        scan_vacuous(result->arena, &program, ns, relevant_by_rank, &constant);
+    }
+    for (s = nr = 0; s < ns; s++) {
+        nr += relevant_by_rank[s];
+    }
+    if (0 == nr) {
+        result->constant = constant;
+    } else if (nr < ns) {
+        result->relevant = arena_mem_new_n(result->arena, *result->relevant, ns);
+        for (s = 0; s < ns; s++) {
+            result->relevant[s] = relevant_by_rank[ranks[s]];
+        }
+        result->relevant_count = nr;
+    }
+}
+
+/**
+ * Sort the symbols and number them, in the program, by their rank among
+ * the relevant ones, ascending or, if greatest_first, descending (for
+ * compute_hash, where the greatest symbol is the lowest bit of a row).
+ * An irrelevant symbol gets the number of the first relevant one (the
+ * result doesn't depend on its value anyway).
+ * Returns the number of relevant symbols, their values being put, in
+ * ascending order, in values.
+ **/
+static size_t remap_symbols(ParseResult *result, bool greatest_first, const uint32_t **values)
+{
+    size_t s, r, ns, nr;
+    uint32_t *map, *relevant_ranks, *relevant_values;
+    const uint32_t *ranks, *sorted;
+
+    ns = symtab_size(result->symbols);
+    nr = result->relevant_count;
+    symtab_sort(result->symbols);
+    sorted = symtab_values(result->symbols);
+    ranks = symtab_ranks(result->symbols);
+    relevant_ranks = NULL;
+    *values = sorted;
+    if (NULL != result->relevant) {
+        bool *relevant_by_rank;
+
+        relevant_by_rank = arena_mem_new_n(result->arena, *relevant_by_rank, ns);
+        for (s = 0; s < ns; s++) {
+            relevant_by_rank[ranks[s]] = result->relevant[s];
+        }
+        relevant_ranks = arena_mem_new_n(result->arena, *relevant_ranks, ns);
+        relevant_values = arena_mem_new_n(result->arena, *relevant_values, nr);
+        for (s = r = 0; s < ns; s++) {
+            if (relevant_by_rank[s]) {
+                relevant_values[r] = sorted[s];
+                relevant_ranks[s] = r++;
+            } else {
+                relevant_ranks[s] = 0;
+            }
+        }
+        *values = relevant_values;
+    }
+    map = arena_mem_new_n(result->arena, *map, ns);
+    for (s = 0; s < ns; s++) {
+        r = NULL == relevant_ranks ? ranks[s] : relevant_ranks[ranks[s]];
+        map[s] = greatest_first ? nr - 1 - r : r;
+    }
+    program_remap(&result->program, map);
+
+    return nr;
+}
+
+/**
+ * Output of a tautology or a contradiction: no symbol and all rows at once
+ **/
+static uint8_t *compute_constant_hash(void *parent, bool value)
+{
+    uint8_t *h;
+    size_t h_len;
+
+    h_len = 0;
+    h = (uint8_t *) allocate_buffer(parent, sizeof(uint32_t) + 1);
+    WRITE_UINT32(h, h_len, 0);
+    h[h_len] = value ? 0xFF : 0x00;
+
+    return h;
+}
+
+static uint8_t *compute_hash(void *parent, ParseResult *result, uint8_t *all_true, uint8_t *all_false)
+{
+    size_t s, ns;
+    uint64_t mask;
+    uint32_t wl, l;
+    uint8_t *h;
+    const uint32_t *values;
+    size_t h_size, h_len, word_len;
+
+    if (SAT_UNKNOWN != result->constant) {
+        *all_true = result->constant;
+        *all_false = !result->constant;
+        return compute_constant_hash(parent, *all_true);
+    }
+    h_len = 0;
+    *all_false = *all_true = TRUE;
+    /* the greatest symbol is the lowest bit */
+    ns = remap_symbols(result, TRUE, &values);
+    h_size = sizeof(uint32_t) + ns * sizeof(uint32_t) + BYTE_LENGTH((1U << ns));
+    h = (uint8_t *) allocate_buffer(parent, h_size);
+    WRITE_UINT32(h, h_len, ns);
+    for (s = 0; s < ns; s++) {
+        WRITE_UINT32(h, h_len, values[s]);
+#ifdef MAXIMAL_OUTPUT
+        if (verbose) {
+            printf(" %4d "/*"(0x%X)"*/, values[s]);
+        }
+#endif /* MAXIMAL_OUTPUT */
+    }
 #ifdef MAXIMAL_OUTPUT
-        printf(" | %4d \n", b);
+    if (verbose) {
+        printf(" | Result ");
+        printf("\n");
+    }
 #endif /* MAXIMAL_OUTPUT */
+    l = 1U << ns;
+    if (l < WORD_BIT) {
+        wl = 1;
+        mask = (UINT64_C(1) << l) - 1;
+        word_len = BYTE_LENGTH(l);
+    } else {
+        wl = l / WORD_BIT;
+        mask = ~UINT64_C(0);
+        word_len = WORD_BIT / CHAR_BIT;
+    }
+    run_table_kernel(result->arena, &result->program, h + h_len, wl, mask, word_len, all_true, all_false);
+#ifdef MAXIMAL_OUTPUT
+    if (verbose) {
+        uint32_t i;
+
+        for (i = 0; i < l; i++) {
+            for (s = 0; s < ns; s++) {
+                printf(" %4d ", !!(i & (1U << (ns - 1 - s))));
+            }
+            printf(" | %4d \n", !!(h[h_len + BITSLOT(i)] & BITMASK(i)));
+        }
     }
+#endif /* MAXIMAL_OUTPUT */
     if (*all_true || *all_false) {
 #ifndef NO_NEED_TO_FREE
         free(h);
 #endif /* !NO_NEED_TO_FREE */
+        h = compute_constant_hash(parent, *all_true);
+    }
+
+    return h;
+}
+
+/* the benchmark (see bench.c) only times compute_hash */
+#if defined(POSTGRESQL) || !defined(BENCHMARK)
+/**
+ * Alternative to compute_hash for a fixed size output: the SHA-256 digest
+ * of what compute_hash would return, computed without the table which is
+ * generated and hashed DIGEST_BLOCK_WORDS words at a time.
+ **/
+#define DIGEST_BLOCK_WORDS 1024
+
+static inline void digest_uint32(SHA256Context *ctx, uint32_t value)
+{
+    value = htonl(value);
+    sha256_update(ctx, &value, sizeof(value));
+}
+
+/**
+ * (Re)start ctx with the output of compute_constant_hash
+ **/
+static void digest_constant(SHA256Context *ctx, bool value)
+{
+    uint8_t rows;
+
+    rows = value ? 0xFF : 0x00;
+    sha256_init(ctx);
+    digest_uint32(ctx, 0);
+    sha256_update(ctx, &rows, sizeof(rows));
+}
+
+static uint8_t *compute_digest(void *parent, ParseResult *result, uint8_t *all_true, uint8_t *all_false)
+{
+    size_t s, ns;
+    uint64_t mask;
+    uint32_t w, wl, l;
+    size_t word_len;
+    uint8_t *h, *block, *stack;
+    const uint32_t *values;
+    GrayPlan *gray;
+    SHA256Context ctx;
+
+    h = (uint8_t *) allocate_buffer(parent, SHA256_DIGEST_LENGTH);
+    if (SAT_UNKNOWN != result->constant) {
+        *all_true = result->constant;
+        *all_false = !result->constant;
+        digest_constant(&ctx, *all_true);
+        sha256_final(&ctx, h);
+        return h;
+    }
+    *all_false = *all_true = TRUE;
+    /* the greatest symbol is the lowest bit */
+    ns = remap_symbols(result, TRUE, &values);
+    sha256_init(&ctx);
+    digest_uint32(&ctx, ns);
+    for (s = 0; s < ns; s++) {
+        digest_uint32(&ctx, values[s]);
+    }
+    l = 1U << ns;
+    if (l < WORD_BIT) {
+        wl = 1;
+        mask = (UINT64_C(1) << l) - 1;
+        word_len = BYTE_LENGTH(l);
+    } else {
+        wl = l / WORD_BIT;
+        mask = ~UINT64_C(0);
+        word_len = WORD_BIT / CHAR_BIT;
+    }
+    block = arena_mem_new_n(result->arena, *block, MIN(wl, DIGEST_BLOCK_WORDS) * word_len);
+    if (NULL == (gray = gray_plan_new(result->arena, &result->program, MIN(wl, DIGEST_BLOCK_WORDS)))) {
+        stack = arena_mem_new_n(result->arena, *stack, (result->program.max_depth + result->program.temporaries + 1) * VALUE_STACK_ALIGNMENT);
+    } else {
+        stack = arena_mem_new_n(result->arena, *stack, (gray->length + 1) * VALUE_STACK_ALIGNMENT);
+    }
+    for (w = 0; w < wl; w += DIGEST_BLOCK_WORDS) {
+        uint32_t last;
+
+        last = MIN(wl, w + DIGEST_BLOCK_WORDS);
+        if (NULL == gray) {
+            fill_table(result->program.code, ALIGNED_VALUE_STACK(stack), block, w, last, mask, word_len, all_true, all_false);
+        } else {
+            fill_table_gray(gray, ALIGNED_VALUE_STACK(stack), block, w, last, mask, word_len, all_true, all_false);
+        }
+        sha256_update(&ctx, block, (last - w) * word_len);
+    }
+    if (*all_true || *all_false) {
+        digest_constant(&ctx, *all_true);
+    }
+    sha256_final(&ctx, h);
+
+    return h;
+}
+
+/**
+ * Alternative to compute_hash for a large number of symbols: the output is
+ * the number of symbols, the symbols (in ascending order) then the reduced
+ * ordered BDD of the query (see bdd_serialize), variable i being the
+ * ith symbol. As for compute_hash, a tautology or a contradiction is
+ * output without any symbol.
+ * Returns NULL if the BDD exceeds max_nodes nodes.
+ **/
+static uint8_t *compute_bdd(void *parent, ParseResult *result, size_t max_nodes, uint8_t *all_true, uint8_t *all_false)
+{
+    BDD *bdd;
+    BDDRef root;
+    uint8_t *h;
+    bool *support;
+    uint32_t *vars;
+    size_t s, ns, nv;
+    const uint32_t *values;
+    size_t h_size, h_len;
+
+    h = NULL;
+    ns = remap_symbols(result, FALSE, &values);
+    bdd = bdd_new(ns, max_nodes);
+    if (SAT_UNKNOWN != result->constant) {
+        root = result->constant ? BDD_TRUE : BDD_FALSE;
+    }
+    if (SAT_UNKNOWN != result->constant || bdd_build(bdd, &result->program, &root)) {
         h_len = 0;
-        h = (uint8_t *) allocate_buffer(parent, sizeof(uint32_t) + 1);
-        WRITE_UINT32(h, h_len, 0);
-        h[h_len] = *all_true ? 0xFF : 0x00;
+        *all_true = BDD_TRUE == root;
+        *all_false = BDD_FALSE == root;
+        /* only the variables the BDD depends on are output, renumbered among them */
+        support = arena_mem_new_n(result->arena, *support, ns);
+        memset(support, 0, ns * sizeof(*support));
+        if (!BDD_IS_TERMINAL(root)) {
+            bdd_support(bdd, root, support);
+        }
+        vars = arena_mem_new_n(result->arena, *vars, ns);
+        for (s = nv = 0; s < ns; s++) {
+            vars[s] = nv;
+            nv += support[s];
+        }
+        h_size = sizeof(uint32_t) + nv * sizeof(uint32_t) + (2 + 3 * bdd_count(bdd, root)) * sizeof(uint32_t);
+        h = (uint8_t *) allocate_buffer(parent, h_size);
+        WRITE_UINT32(h, h_len, nv);
+        for (s = 0; s < ns; s++) {
+            if (support[s]) {
+                WRITE_UINT32(h, h_len, values[s]);
+            }
+        }
+        h_len += bdd_serialize(bdd, root, nv == ns ? NULL : vars, h + h_len);
+        assert(h_len == h_size);
+    }
+#ifndef POSTGRESQL
+    else if (bdd_too_deep(bdd)) {
+        report_error("too many variables along a path of the BDD, max is %d", BDD_MAX_DEPTH);
+    } else {
+        report_error("too many BDD nodes, max is %" PRIszu, max_nodes);
     }
+#endif /* !POSTGRESQL */
+    bdd_destroy(bdd);
 
     return h;
 }
 
+/**
+ * Copy in out (of expr_len characters at least) the expression without
+ * its ignorable characters, except those between 2 digits: '1 2' or
+ * '10 2' are invalid, unlike '12' or '102', so they must not be mistaken
+ * for them. Returns the length of the normalized expression.
+ **/
+static size_t normalize_expression(const char *expr, size_t expr_len, char *out)
+{
+    char *k;
+    const char *p, *end;
+
+    k = out;
+    for (p = expr, end = expr + expr_len; p < end; p++) {
+        if (T_IGNORABLES != assignments[(unsigned char) *p]) {
+            *k++ = *p;
+        } else if (k > out && '0' <= k[-1] && k[-1] <= '9' && p + 1 < end && '0' <= p[1] && p[1] <= '9') {
+            *k++ = *p;
+        }
+    }
+
+    return k - out;
+}
+#endif /* POSTGRESQL || !BENCHMARK */
+
 #ifdef POSTGRESQL
 
+/**
+ * Everything is allocated in the arena (a child memory context) during a
+ * compilation, except the result which has to outlive it
+ **/
+static MemoryContext output_context;
+
 static char *allocate_buffer(void *parent, size_t h_size)
 {
     char *h;
     bytea *ba;
 
     h_size += VARHDRSZ;
-    ba = (bytea *) palloc0(h_size);
+    ba = (bytea *) MemoryContextAllocZero(output_context, h_size);
     SET_VARSIZE(ba, h_size);
     h = VARDATA_ANY(ba);
     *((Datum *) parent) = PointerGetDatum(ba);
@@ -596,6 +1939,216 @@ static char *allocate_buffer(void *parent, size_t h_size)
     return h;
 }
 
+/**
+ * Compiled queries are cached at two levels:
+ * - per call site (in fn_extra), the last expression, as is, with its result
+ * - per backend, a bounded LRU keyed by the expression without its
+ *   ignorable characters
+ * Keys are prefixed by the engine and the GUC which can make a compilation
+ * fail, so a result is never reused under other limits. Results don't
+ * depend on throw_false and throw_true (they are checked after a hit as
+ * after a compilation) and only successful compilations are cached.
+ **/
+typedef struct {
+    char *key;
+    size_t key_len;
+    bytea *value;
+    uint8_t all_true;
+    uint8_t all_false;
+} CallSiteCache;
+
+static Cache *query_cache = NULL;
+
+static char *query_cache_key(MemoryContext context, char engine, const char *expr, size_t expr_len, bool normalize, size_t *key_len)
+{
+    int limit;
+    char *key, *k;
+
+    limit = 'b' == engine ? intarray_query_int_max_bdd_nodes : intarray_query_int_max_symbols;
+    k = key = MemoryContextAlloc(context, 1 + 2 * sizeof(int) + expr_len);
+    *k++ = engine;
+    memcpy(k, &intarray_query_int_max_stack_size, sizeof(int));
+    k += sizeof(int);
+    memcpy(k, &limit, sizeof(int));
+    k += sizeof(int);
+    if (normalize) {
+        k += normalize_expression(expr, expr_len, k);
+    } else {
+        memcpy(k, expr, expr_len);
+        k += expr_len;
+    }
+    *key_len = k - key;
+
+    return key;
+}
+
+static bool query_cache_get(FunctionCallInfo fcinfo, char engine, const char *expr, size_t expr_len, Datum *retval, uint8_t *all_true, uint8_t *all_false)
+{
+    bytea *ba;
+    char *key;
+    bool found;
+    size_t key_len;
+    CachedResult cached;
+    CallSiteCache *site;
+
+    if (0 == intarray_query_int_cache_size) {
+        return FALSE;
+    }
+    if (NULL == query_cache) {
+        query_cache = cache_new();
+    }
+    key = query_cache_key(CurrentMemoryContext, engine, expr, expr_len, FALSE, &key_len);
+    site = (CallSiteCache *) fcinfo->flinfo->fn_extra;
+    found = NULL != site && site->key_len == key_len && 0 == memcmp(site->key, key, key_len);
+    pfree(key);
+    if (found) {
+        cache_hit(query_cache);
+        ba = (bytea *) palloc(VARSIZE(site->value));
+        memcpy(ba, site->value, VARSIZE(site->value));
+        *all_true = site->all_true;
+        *all_false = site->all_false;
+    } else {
+        key = query_cache_key(CurrentMemoryContext, engine, expr, expr_len, TRUE, &key_len);
+        found = cache_lookup(query_cache, key, key_len, &cached);
+        pfree(key);
+        if (!found) {
+            return FALSE;
+        }
+        ba = (bytea *) palloc(VARHDRSZ + cached.size);
+        SET_VARSIZE(ba, VARHDRSZ + cached.size);
+        memcpy(VARDATA(ba), cached.data, cached.size);
+        *all_true = cached.all_true;
+        *all_false = cached.all_false;
+    }
+    *retval = PointerGetDatum(ba);
+
+    return TRUE;
+}
+
+static void query_cache_put(FunctionCallInfo fcinfo, char engine, const char *expr, size_t expr_len, Datum retval, uint8_t all_true, uint8_t all_false)
+{
+    bytea *ba;
+    char *key;
+    size_t key_len;
+    CachedResult cached;
+    CallSiteCache *site;
+
+    if (0 == intarray_query_int_cache_size) {
+        return;
+    }
+    ba = (bytea *) DatumGetPointer(retval);
+    cached.data = (const uint8_t *) VARDATA(ba);
+    cached.size = VARSIZE(ba) - VARHDRSZ;
+    cached.all_true = all_true;
+    cached.all_false = all_false;
+    key = query_cache_key(CurrentMemoryContext, engine, expr, expr_len, TRUE, &key_len);
+    cache_insert(query_cache, key, key_len, &cached, (size_t) intarray_query_int_cache_size * 1024);
+    pfree(key);
+    /* the call site only keeps its last expression */
+    if (NULL == (site = (CallSiteCache *) fcinfo->flinfo->fn_extra)) {
+        site = MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, sizeof(*site));
+        fcinfo->flinfo->fn_extra = site;
+    } else {
+        pfree(site->key);
+        pfree(site->value);
+    }
+    site->key = query_cache_key(fcinfo->flinfo->fn_mcxt, engine, expr, expr_len, FALSE, &site->key_len);
+    site->value = MemoryContextAlloc(fcinfo->flinfo->fn_mcxt, VARSIZE(ba));
+    memcpy(site->value, ba, VARSIZE(ba));
+    site->all_true = all_true;
+    site->all_false = all_false;
+}
+
+/**
+ * Cumulative counters, per backend and by function, since the start of
+ * the backend or the last call to query_int_parser_stats_reset. Times
+ * are those of the compilations (a cache hit doesn't parse anything).
+ * The histogram counts compiled queries by number of (relevant) symbols:
+ * 0 (constant), 1, 2-3, 4-7, 8-15, 16-31 and 32 or more.
+ **/
+# define STATS_SYMBOLS_BUCKETS 7
+
+typedef struct {
+    const char *function;
+    int64 calls;
+    int64 cache_hits;
+    int64 parse_errors;
+    int64 limit_errors; /* max_symbols or max_bdd_nodes exceeded */
+    int64 false_errors; /* throw_false */
+    int64 true_errors; /* throw_true */
+    int64 symbols[STATS_SYMBOLS_BUCKETS];
+    int64 rows; /* of the truth tables generated */
+    int64 bytes; /* returned */
+    instr_time parse_time;
+    instr_time analyze_time; /* detection of constants and irrelevant symbols */
+    instr_time compute_time;
+} QueryIntStats;
+
+enum {
+    STATS_TABLE,
+    STATS_DIGEST,
+    STATS_BDD,
+    _STATS_COUNT
+};
+
+static QueryIntStats query_int_stats[_STATS_COUNT];
+
+static void query_int_stats_reset(void)
+{
+    memset(query_int_stats, 0, sizeof(query_int_stats));
+    query_int_stats[STATS_TABLE].function = "compile_query_int";
+    query_int_stats[STATS_DIGEST].function = "compile_query_int_digest";
+    query_int_stats[STATS_BDD].function = "compile_query_int_bdd";
+}
+
+static QueryIntStats *query_int_stats_of(char engine)
+{
+    switch (engine) {
+        case 'd':
+            return &query_int_stats[STATS_DIGEST];
+        case 'b':
+            return &query_int_stats[STATS_BDD];
+        case 't':
+        default:
+            return &query_int_stats[STATS_TABLE];
+    }
+}
+
+static void query_int_stats_symbols(QueryIntStats *stats, size_t symbols)
+{
+    int bucket;
+
+    for (bucket = 0; symbols > 0 && bucket < STATS_SYMBOLS_BUCKETS - 1; bucket++) {
+        symbols >>= 1;
+    }
+    ++stats->symbols[bucket];
+}
+
+/**
+ * parse, the errors (which don't return) being counted
+ **/
+static bool parse_counted(QueryIntStats *stats, Arena *arena, const char *expr, const char * const end, ParseResult *result)
+{
+    bool parsed;
+    instr_time start, stop;
+
+    INSTR_TIME_SET_CURRENT(start);
+    PG_TRY();
+    {
+        parsed = parse(arena, expr, end, result);
+    }
+    PG_CATCH();
+    {
+        ++stats->parse_errors;
+        PG_RE_THROW();
+    }
+    PG_END_TRY();
+    INSTR_TIME_SET_CURRENT(stop);
+    INSTR_TIME_ACCUM_DIFF(stats->parse_time, stop, start);
+
+    return parsed;
+}
+
 # define PG_RETVAL_NULL() \
     do { \
         fcinfo->isnull = true; \
@@ -608,15 +2161,23 @@ static char *allocate_buffer(void *parent, size_t h_size)
         retval = PointerGetDatum(value); \
     } while (0);
 
-Datum compile_query_int(PG_FUNCTION_ARGS)
+/**
+ * Common part of compile_query_int and compile_query_int_digest, engine
+ * being 't' (truth table) or 'd' (its digest)
+ **/
+static Datum compile_query_int_table(PG_FUNCTION_ARGS, char engine)
 {
     char *expr;
+    Arena *arena;
     text *texpr;
     Datum retval;
+    MemoryContext old_context;
     size_t expr_len;
     ParseResult result;
+    QueryIntStats *stats;
     uint8_t all_true, all_false;
     bool throw_false, throw_true;
+    instr_time start, stop;
 
     texpr = PG_GETARG_TEXT_P(0);
     throw_false = PG_GETARG_BOOL(1);
@@ -625,10 +2186,29 @@ Datum compile_query_int(PG_FUNCTION_ARGS)
     expr = VARDATA(texpr);
 
     PG_RETVAL_NULL();
-    if (!parse(expr, expr + expr_len, &result)) {
+    arena = NULL;
+    stats = query_int_stats_of(engine);
+    ++stats->calls;
+    if (query_cache_get(fcinfo, engine, expr, expr_len, &retval, &all_true, &all_false)) {
+        ++stats->cache_hits;
+        fcinfo->isnull = false;
+        goto check;
+    }
+    output_context = CurrentMemoryContext;
+    arena = arena_new(0);
+    old_context = arena_switch_to(arena);
+    if (!parse_counted(stats, arena, expr, expr + expr_len, &result)) {
         goto end;
     }
-    if (hashtable_size(result.symbols) > intarray_query_int_max_symbols) {
+    INSTR_TIME_SET_CURRENT(start);
+    simplify(&result);
+    detect_constant(&result);
+    eliminate_vacuous(&result, (size_t) intarray_query_int_max_symbols);
+    INSTR_TIME_SET_CURRENT(stop);
+    INSTR_TIME_ACCUM_DIFF(stats->analyze_time, stop, start);
+    query_int_stats_symbols(stats, SAT_UNKNOWN == result.constant ? result.relevant_count : 0);
+    if (SAT_UNKNOWN == result.constant && result.relevant_count > (size_t) intarray_query_int_max_symbols) {
+        ++stats->limit_errors;
         ereport(
             ERROR,
             (
@@ -640,8 +2220,128 @@ Datum compile_query_int(PG_FUNCTION_ARGS)
     }
 
     fcinfo->isnull = false;
-    compute_hash(&retval, &result, &all_true, &all_false);
+    if (SAT_UNKNOWN == result.constant) {
+        stats->rows += INT64CONST(1) << result.relevant_count;
+    }
+    INSTR_TIME_SET_CURRENT(start);
+    if ('d' == engine) {
+        compute_digest(&retval, &result, &all_true, &all_false);
+    } else {
+        compute_hash(&retval, &result, &all_true, &all_false);
+    }
+    INSTR_TIME_SET_CURRENT(stop);
+    INSTR_TIME_ACCUM_DIFF(stats->compute_time, stop, start);
+    query_cache_put(fcinfo, engine, expr, expr_len, retval, all_true, all_false);
+check:
+    stats->bytes += VARSIZE(DatumGetPointer(retval)) - VARHDRSZ;
+    if (throw_false && all_false) {
+        ++stats->false_errors;
+        ereport(
+            ERROR,
+            (
+                errcode(ERRCODE_DATA_EXCEPTION),
+                errmsg("query_int is known to be always false")
+            )
+        );
+        PG_RETVAL_NULL();
+        pfree(DatumGetPointer(retval));
+        goto end;
+    }
+    if (throw_true && all_true) {
+        ++stats->true_errors;
+        ereport(
+            ERROR,
+            (
+                errcode(ERRCODE_DATA_EXCEPTION),
+                errmsg("query_int is known to be always true")
+            )
+        );
+        PG_RETVAL_NULL();
+        pfree(DatumGetPointer(retval));
+        goto end;
+    }
+
+end:
+    if (NULL != arena) {
+        MemoryContextSwitchTo(old_context);
+        arena_destroy(arena);
+    }
+
+    return retval;
+}
+
+Datum compile_query_int(PG_FUNCTION_ARGS)
+{
+    return compile_query_int_table(fcinfo, 't');
+}
+
+Datum compile_query_int_digest(PG_FUNCTION_ARGS)
+{
+    return compile_query_int_table(fcinfo, 'd');
+}
+
+Datum compile_query_int_bdd(PG_FUNCTION_ARGS)
+{
+    char *expr;
+    Arena *arena;
+    text *texpr;
+    Datum retval;
+    MemoryContext old_context;
+    size_t expr_len;
+    ParseResult result;
+    QueryIntStats *stats;
+    uint8_t all_true, all_false;
+    bool throw_false, throw_true;
+    instr_time start, stop;
+
+    texpr = PG_GETARG_TEXT_P(0);
+    throw_false = PG_GETARG_BOOL(1);
+    throw_true = PG_GETARG_BOOL(2);
+    expr_len = VARSIZE(texpr) - VARHDRSZ;
+    expr = VARDATA(texpr);
+
+    PG_RETVAL_NULL();
+    arena = NULL;
+    stats = query_int_stats_of('b');
+    ++stats->calls;
+    if (query_cache_get(fcinfo, 'b', expr, expr_len, &retval, &all_true, &all_false)) {
+        ++stats->cache_hits;
+        fcinfo->isnull = false;
+        goto check;
+    }
+    output_context = CurrentMemoryContext;
+    arena = arena_new(0);
+    old_context = arena_switch_to(arena);
+    if (!parse_counted(stats, arena, expr, expr + expr_len, &result)) {
+        goto end;
+    }
+
+    INSTR_TIME_SET_CURRENT(start);
+    simplify(&result);
+    detect_constant(&result);
+    INSTR_TIME_SET_CURRENT(stop);
+    INSTR_TIME_ACCUM_DIFF(stats->analyze_time, stop, start);
+    query_int_stats_symbols(stats, SAT_UNKNOWN == result.constant ? symtab_size(result.symbols) : 0);
+    INSTR_TIME_SET_CURRENT(start);
+    if (NULL == compute_bdd(&retval, &result, intarray_query_int_max_bdd_nodes, &all_true, &all_false)) {
+        ++stats->limit_errors;
+        ereport(
+            ERROR,
+            (
+                errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                errmsg("query_int exceeds the maximum of BDD nodes allowed by 'intarray.query_int.max_bdd_nodes' GUC (%d)", intarray_query_int_max_bdd_nodes)
+            )
+        );
+        goto end;
+    }
+    INSTR_TIME_SET_CURRENT(stop);
+    INSTR_TIME_ACCUM_DIFF(stats->compute_time, stop, start);
+    fcinfo->isnull = false;
+    query_cache_put(fcinfo, 'b', expr, expr_len, retval, all_true, all_false);
+check:
+    stats->bytes += VARSIZE(DatumGetPointer(retval)) - VARHDRSZ;
     if (throw_false && all_false) {
+        ++stats->false_errors;
         ereport(
             ERROR,
             (
@@ -654,6 +2354,7 @@ Datum compile_query_int(PG_FUNCTION_ARGS)
         goto end;
     }
     if (throw_true && all_true) {
+        ++stats->true_errors;
         ereport(
             ERROR,
             (
@@ -667,19 +2368,188 @@ Datum compile_query_int(PG_FUNCTION_ARGS)
     }
 
 end:
-# ifndef NO_NEED_TO_FREE
-    hashtable_destroy(result.symbols);
-    if (NULL != result.root) {
-        free_tree(result.root);
+    if (NULL != arena) {
+        MemoryContextSwitchTo(old_context);
+        arena_destroy(arena);
+    }
+
+    return retval;
+}
+
+Datum query_int_cache_stats(PG_FUNCTION_ARGS)
+{
+    bool nulls[4];
+    Datum values[4];
+    TupleDesc tupdesc;
+    CacheStats stats;
+
+    if (TYPEFUNC_COMPOSITE != get_call_result_type(fcinfo, NULL, &tupdesc)) {
+        ereport(
+            ERROR,
+            (
+                errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                errmsg("function returning record called in context that cannot accept type record")
+            )
+        );
+    }
+    if (NULL == query_cache) {
+        memset(&stats, 0, sizeof(stats));
+    } else {
+        cache_stats(query_cache, &stats);
+    }
+    memset(nulls, 0, sizeof(nulls));
+    values[0] = Int64GetDatum((int64) stats.hits);
+    values[1] = Int64GetDatum((int64) stats.misses);
+    values[2] = Int64GetDatum((int64) stats.entries);
+    values[3] = Int64GetDatum((int64) stats.size);
+
+    PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(BlessTupleDesc(tupdesc), values, nulls)));
+}
+
+/**
+ * One row by function (see QueryIntStats), times in milliseconds
+ **/
+Datum query_int_parser_stats(PG_FUNCTION_ARGS)
+{
+    FuncCallContext *funcctx;
+
+    if (SRF_IS_FIRSTCALL()) {
+        TupleDesc tupdesc;
+        MemoryContext old_context;
+
+        funcctx = SRF_FIRSTCALL_INIT();
+        old_context = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+        if (TYPEFUNC_COMPOSITE != get_call_result_type(fcinfo, NULL, &tupdesc)) {
+            ereport(
+                ERROR,
+                (
+                    errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                    errmsg("function returning record called in context that cannot accept type record")
+                )
+            );
+        }
+        funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+        funcctx->max_calls = ARRAY_SIZE(query_int_stats);
+        MemoryContextSwitchTo(old_context);
+    }
+    funcctx = SRF_PERCALL_SETUP();
+    if (funcctx->call_cntr < funcctx->max_calls) {
+        int i;
+        text *function;
+        size_t function_len;
+        bool nulls[13];
+        Datum values[13], buckets[STATS_SYMBOLS_BUCKETS];
+        const QueryIntStats *stats;
+
+        stats = &query_int_stats[funcctx->call_cntr];
+        function_len = strlen(stats->function);
+        function = (text *) palloc(VARHDRSZ + function_len);
+        SET_VARSIZE(function, VARHDRSZ + function_len);
+        memcpy(VARDATA(function), stats->function, function_len);
+        for (i = 0; i < STATS_SYMBOLS_BUCKETS; i++) {
+            buckets[i] = Int64GetDatum(stats->symbols[i]);
+        }
+        memset(nulls, 0, sizeof(nulls));
+        values[0] = PointerGetDatum(function);
+        values[1] = Int64GetDatum(stats->calls);
+        values[2] = Int64GetDatum(stats->cache_hits);
+        values[3] = Int64GetDatum(stats->parse_errors);
+        values[4] = Int64GetDatum(stats->limit_errors);
+        values[5] = Int64GetDatum(stats->false_errors);
+        values[6] = Int64GetDatum(stats->true_errors);
+        values[7] = PointerGetDatum(construct_array(buckets, STATS_SYMBOLS_BUCKETS, INT8OID, sizeof(int64), FLOAT8PASSBYVAL, 'd'));
+        values[8] = Int64GetDatum(stats->rows);
+        values[9] = Int64GetDatum(stats->bytes);
+        values[10] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(stats->parse_time));
+        values[11] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(stats->analyze_time));
+        values[12] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(stats->compute_time));
+        SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heap_form_tuple(funcctx->tuple_desc, values, nulls)));
+    }
+    SRF_RETURN_DONE(funcctx);
+}
+
+Datum query_int_parser_stats_reset(PG_FUNCTION_ARGS)
+{
+    query_int_stats_reset();
+
+    PG_RETURN_VOID();
+}
+
+Datum query_int_is_valid(PG_FUNCTION_ARGS)
+{
+    text *texpr;
+    size_t symbols;
+
+    texpr = PG_GETARG_TEXT_P(0);
+
+    PG_RETURN_BOOL(validate(VARDATA(texpr), VARDATA(texpr) + VARSIZE(texpr) - VARHDRSZ, &symbols));
+}
+
+/**
+ * Number of distinct symbols of a query, or NULL if it is invalid, without
+ * parsing it nor enforcing any limit.
+ **/
+Datum query_int_count_symbols(PG_FUNCTION_ARGS)
+{
+    text *texpr;
+    size_t symbols;
+
+    texpr = PG_GETARG_TEXT_P(0);
+    if (!validate(VARDATA(texpr), VARDATA(texpr) + VARSIZE(texpr) - VARHDRSZ, &symbols)) {
+        PG_RETURN_NULL();
+    }
+
+    PG_RETURN_INT32((int32) symbols);
+}
+
+/**
+ * Does an int[] match a query compiled by compile_query_int? Only the
+ * symbols of the query are looked up in the array (see match.h), the
+ * query itself is not evaluated.
+ **/
+Datum compiled_query_int_match(PG_FUNCTION_ARGS)
+{
+    bytea *compiled;
+    ArrayType *array;
+    CompiledQuery query;
+
+    array = PG_GETARG_ARRAYTYPE_P(0);
+    compiled = PG_GETARG_BYTEA_P(1);
+    if (ARR_NDIM(array) > 1) {
+        ereport(
+            ERROR,
+            (
+                errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
+                errmsg("array must be one-dimensional")
+            )
+        );
+    }
+    if (array_contains_nulls(array)) {
+        ereport(
+            ERROR,
+            (
+                errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+                errmsg("array must not contain nulls")
+            )
+        );
+    }
+    if (!compiled_query_init(&query, (const uint8_t *) VARDATA(compiled), VARSIZE(compiled) - VARHDRSZ)) {
+        ereport(
+            ERROR,
+            (
+                errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                errmsg("invalid compiled query_int (only the results of compile_query_int can be matched)")
+            )
+        );
     }
-# endif /* !NO_NEED_TO_FREE */
 
-    return retval;
+    PG_RETURN_BOOL(compiled_query_match(&query, (const int32_t *) ARR_DATA_PTR(array), ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array))));
 }
 
 void _PG_init(void)
 {
     compile_start_states();
+    query_int_stats_reset();
 
     DefineCustomIntVariable(
         "intarray.query_int.max_symbols",
@@ -690,6 +2560,32 @@ void _PG_init(void)
         PGC_USERSET, 0,
 # if PG_VERSION_NUM >= 90100
         NULL,
+# endif /* PostgreSQL >= 9.1.0 */
+        NULL,
+        NULL
+    );
+    DefineCustomIntVariable(
+        "intarray.query_int.max_bdd_nodes",
+        gettext_noop("maximum number of nodes of the BDD of a query_int."),
+        gettext_noop("The default value is 1048576."),
+        &intarray_query_int_max_bdd_nodes,
+        1048576, 2, INT_MAX,
+        PGC_USERSET, 0,
+# if PG_VERSION_NUM >= 90100
+        NULL,
+# endif /* PostgreSQL >= 9.1.0 */
+        NULL,
+        NULL
+    );
+    DefineCustomIntVariable(
+        "intarray.query_int.cache_size",
+        gettext_noop("maximum size of the cache of compiled query_int (0 to disable it)."),
+        gettext_noop("The default value is 16MB."),
+        &intarray_query_int_cache_size,
+        16384, 0, INT_MAX / 1024,
+        PGC_USERSET, GUC_UNIT_KB,
+# if PG_VERSION_NUM >= 90100
+        NULL,
 # endif /* PostgreSQL >= 9.1.0 */
         NULL,
         NULL
@@ -723,30 +2619,86 @@ static char *allocate_buffer(void *parent, size_t h_size)
     return h;
 }
 
-static void print_tree_node(QINode *n, int ident)
+# ifndef EXIT_USAGE
+#  define EXIT_USAGE -2
+# endif /* !EXIT_USAGE */
+
+/* the benchmark (see bench.c) only needs the above, the command line tool follows */
+# ifndef BENCHMARK
+static const char *opcode_name(Opcode opcode)
 {
-    if (NULL != n->left) {
-        print_tree_node(n->left, ident + 1);
+    size_t i;
+
+    /* not written in a query */
+    switch (opcode) {
+        case OP_LOAD:
+            return "<load>";
+        case OP_STORE:
+            return "<store>";
+        default:
+            break;
     }
-    printf("%*c%s\n", ident * 4, ' ', available_nodes[n->type].name);
-    if (NULL != n->right) {
-        print_tree_node(n->right, ident + 1);
+    for (i = 0; i < ARRAY_SIZE(available_nodes); i++) {
+        if (opcode == available_nodes[i].opcode) {
+            return available_nodes[i].name;
+        }
     }
+
+    return "?";
 }
 
-static void print_tree(QINode *root)
+/* starts[i] is the index of the first instruction of the operand ending with the instruction i */
+static void print_tree_node(const Program *program, const size_t *starts, size_t i, int ident)
 {
-    assert(NULL != root);
+    Opcode opcode;
 
-    print_tree_node(root, 0);
+    opcode = OPCODE(program->code[i]);
+    if (OP_NOT == opcode || OP_STORE == opcode) {
+        print_tree_node(program, starts, i - 1, ident + 1);
+    } else if (OP_PUSH != opcode && OP_LOAD != opcode) {
+        print_tree_node(program, starts, starts[i - 1] - 1, ident + 1);
+    }
+    if (OP_LOAD == opcode || OP_STORE == opcode) {
+        printf("%*c%s %" PRIu32 "\n", ident * 4, ' ', opcode_name(opcode), OPERAND(program->code[i]) - (uint32_t) program->max_depth);
+    } else {
+        printf("%*c%s\n", ident * 4, ' ', opcode_name(opcode));
+    }
+    if (OP_AND == opcode || OP_OR == opcode || OP_XOR == opcode) {
+        print_tree_node(program, starts, i - 1, ident + 1);
+    }
+}
+
+static void print_tree(const Program *program)
+{
+    size_t i, *starts, *stack, *sp;
+
+    assert(program->length > 1);
+
+    starts = mem_new_n(*starts, program->length);
+    sp = stack = mem_new_n(*stack, program->max_depth);
+    for (i = 0; OP_END != OPCODE(program->code[i]); i++) {
+        switch (OPCODE(program->code[i])) {
+            case OP_PUSH:
+            case OP_LOAD:
+                *sp++ = i;
+                break;
+            case OP_NOT:
+            case OP_STORE:
+                break;
+            default:
+                --sp;
+                break;
+        }
+        starts[i] = sp[-1];
+    }
+    print_tree_node(program, starts, i - 1, 0);
+    free(stack);
+    free(starts);
 }
 
-# ifndef EXIT_USAGE
-#  define EXIT_USAGE -2
-# endif /* !EXIT_USAGE */
 static void usage(void)
 {
-    fprintf(stderr, "%s: [EXPR]...\n", "query_int_parser");
+    fprintf(stderr, "%s: [-e table|bdd|digest] [-c] [-g] [-j THREADS] [-m INT,...[:INT,...]] (-f FILE | EXPR...)\n", "query_int_parser");
     exit(EXIT_USAGE);
 }
 
@@ -775,65 +2727,753 @@ int strcmp_l(
 
 static const char hexdigits[] = "0123456789ABCDEF";
 
+enum {
+    ENGINE_TABLE,
+    ENGINE_BDD,
+    ENGINE_DIGEST
+};
+
+# define DEFAULT_MAX_BDD_NODES 1048576
+
+/**
+ * Parse and compile the expression [expr;end[ with the given engine.
+ * Return the result (to free) or NULL on error (reported through
+ * report_error). The memory allocated in the arena can be released by
+ * the caller as soon as it returns.
+ **/
+static uint8_t *compile_expression(Arena *arena, int engine, const char *expr, const char * const end, size_t *h_size, uint8_t *all_true, uint8_t *all_false)
+{
+    uint8_t *h;
+    ParseResult result;
+
+    h = NULL;
+    if (!parse(arena, expr, end, &result)) {
+        goto end;
+    }
+    simplify(&result);
+    detect_constant(&result);
+    if (ENGINE_BDD != engine) {
+        eliminate_vacuous(&result, sizeof(uint32_t) * CHAR_BIT - 1);
+    }
+    if (ENGINE_BDD != engine && SAT_UNKNOWN == result.constant && result.relevant_count > (sizeof(uint32_t) * CHAR_BIT - 1)) {
+        report_error("too many symbols, max is %ld", sizeof(uint32_t) * CHAR_BIT - 1);
+        goto end;
+    }
+    if (verbose) {
+        printf("=========\n");
+        print_tree(&result.program);
+        printf("=========\n");
+    }
+    if (ENGINE_BDD == engine) {
+        /* on error, compute_bdd reports which limit was exceeded */
+        h = compute_bdd(h_size, &result, DEFAULT_MAX_BDD_NODES, all_true, all_false);
+    } else if (ENGINE_DIGEST == engine) {
+        h = compute_digest(h_size, &result, all_true, all_false);
+    } else {
+        h = compute_hash(h_size, &result, all_true, all_false);
+    }
+end:
+    program_free(&result.program);
+
+    return h;
+}
+
+/**
+ * Grouping mode: instead of being compared pairwise, the results are
+ * sorted (by hash, length then content) so that equivalent expressions
+ * end up next to each other, in O(n log n). Each class is then numbered
+ * by order of first appearance and its members printed, in input order,
+ * one by line: class id, a tab and the expression.
+ **/
+typedef struct {
+    uint64_t hash;
+    size_t index;
+    size_t first; /* index of the first member of its class */
+    char *expr;
+    size_t expr_len;
+    uint8_t *h;
+    size_t h_size;
+} GroupMember;
+
+static bool grouping = FALSE;
+static GroupMember *members = NULL;
+static size_t members_count = 0, members_allocated = 0;
+
+static uint64_t group_hash(const uint8_t *h, size_t h_size)
+{
+    size_t i;
+    uint64_t hash;
+
+    /* FNV-1a */
+    hash = UINT64_C(0xCBF29CE484222325);
+    for (i = 0; i < h_size; i++) {
+        hash ^= h[i];
+        hash *= UINT64_C(0x100000001B3);
+    }
+
+    return hash;
+}
+
+static void group_add(const char *expr, size_t expr_len, const uint8_t *h, size_t h_size)
+{
+    GroupMember *m;
+
+    if (members_count == members_allocated) {
+        members_allocated = MAX(2 * members_allocated, 64);
+        members = mem_renew(members, *members, members_allocated);
+    }
+    m = &members[members_count];
+    m->hash = group_hash(h, h_size);
+    m->index = members_count++;
+    m->expr = mem_new_n(*m->expr, expr_len);
+    memcpy(m->expr, expr, expr_len);
+    m->expr_len = expr_len;
+    m->h = mem_new_n(*m->h, h_size);
+    memcpy(m->h, h, h_size);
+    m->h_size = h_size;
+}
+
+static int group_cmp_result(const void *a, const void *b)
+{
+    int cmp;
+    const GroupMember *ma, *mb;
+
+    ma = (const GroupMember *) a;
+    mb = (const GroupMember *) b;
+    if (ma->hash != mb->hash) {
+        return ma->hash < mb->hash ? -1 : 1;
+    }
+    if (ma->h_size != mb->h_size) {
+        return ma->h_size < mb->h_size ? -1 : 1;
+    }
+    if (0 != (cmp = memcmp(ma->h, mb->h, ma->h_size))) {
+        return cmp;
+    }
+
+    return ma->index < mb->index ? -1 : ma->index > mb->index;
+}
+
+static int group_cmp_class(const void *a, const void *b)
+{
+    const GroupMember *ma, *mb;
+
+    ma = (const GroupMember *) a;
+    mb = (const GroupMember *) b;
+    if (ma->first != mb->first) {
+        return ma->first < mb->first ? -1 : 1;
+    }
+
+    return ma->index < mb->index ? -1 : ma->index > mb->index;
+}
+
+static void group_print(void)
+{
+    size_t i, class;
+
+    qsort(members, members_count, sizeof(*members), group_cmp_result);
+    for (i = 0; i < members_count; i++) {
+        if (0 != i && members[i].hash == members[i - 1].hash && members[i].h_size == members[i - 1].h_size && 0 == memcmp(members[i].h, members[i - 1].h, members[i].h_size)) {
+            members[i].first = members[i - 1].first;
+        } else {
+            members[i].first = members[i].index;
+        }
+    }
+    qsort(members, members_count, sizeof(*members), group_cmp_class);
+    for (i = class = 0; i < members_count; i++) {
+        if (0 == i || members[i].first != members[i - 1].first) {
+            ++class;
+        }
+        printf("%zu\t%.*s\n", class, I(members[i].expr_len), members[i].expr);
+        free(members[i].expr);
+        free(members[i].h);
+    }
+    free(members);
+    members = NULL;
+    members_count = members_allocated = 0;
+}
+
+/**
+ * Write on stdout a line made of the expression, a tab and either the
+ * result in hexadecimal or "ERROR: " followed by the first line of the
+ * error message (in grouping mode, keep the result for group_print and
+ * report the error on stderr)
+ **/
+static void print_result(const char *expr, size_t expr_len, const uint8_t *h, size_t h_size, const char *error)
+{
+    if (grouping) {
+        if (NULL == h) {
+            fprintf(stderr, "%.*s: %s\n", I(expr_len), expr, error);
+        } else {
+            group_add(expr, expr_len, h, h_size);
+        }
+        return;
+    }
+    fwrite(expr, sizeof(*expr), expr_len, stdout);
+    putchar('\t');
+    if (NULL == h) {
+        printf("ERROR: %.*s\n", I(strcspn(error, "\n")), error);
+    } else {
+        size_t i;
+
+        for (i = 0; i < h_size; i++) {
+            putchar_unlocked(hexdigits[h[i] >> 4]);
+            putchar_unlocked(hexdigits[h[i] & 0x0F]);
+        }
+        putchar('\n');
+    }
+}
+
+/**
+ * Compile each line of fp and print its result (see print_result).
+ * Memory usage only depends on the longest line, not on their number.
+ **/
+static int compile_stream(FILE *fp, int engine)
+{
+    char *line;
+    Arena *arena;
+    ssize_t read;
+    int ret;
+    size_t line_size;
+
+    ret = EXIT_SUCCESS;
+    line = NULL;
+    line_size = 0;
+    arena = arena_new(0);
+    while (-1 != (read = getline(&line, &line_size, fp))) {
+        uint8_t *h;
+        size_t h_size;
+        uint8_t all_true, all_false;
+
+        if (read > 0 && '\n' == line[read - 1]) {
+            --read;
+        }
+        if (read > 0 && '\r' == line[read - 1]) {
+            --read;
+        }
+        if (NULL == (h = compile_expression(arena, engine, line, line + read, &h_size, &all_true, &all_false))) {
+            ret = EXIT_FAILURE;
+        }
+        print_result(line, read, h, h_size, error_message);
+        if (NULL != h) {
+            free(h);
+        }
+        arena_reset(arena);
+    }
+    if (ferror(fp)) {
+        perror("getline");
+        ret = EXIT_FAILURE;
+    }
+    arena_destroy(arena);
+    free(line);
+
+    return ret;
+}
+
+/**
+ * Bulk mode: the file is mapped in memory and its lines, parsed in place,
+ * are compiled by a pool of threads by batches of BULK_BATCH_LINES lines
+ * (to bound memory usage), the results of a batch being printed in input
+ * order once all of them are known.
+ *
+ * The cost of a compilation grows exponentially with the number of
+ * symbols, so the lines of a batch are sorted by decreasing estimated cost
+ * (number of integers, then length) and dealt round-robin to the workers.
+ * Each worker compiles its own lines, most expensive first, then steals
+ * the cheapest remaining ones of the others until there is none left.
+ **/
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+
+# define BULK_BATCH_LINES 65536
+
+typedef struct {
+    const char *expr;
+    size_t len;
+    uint64_t cost;
+    uint8_t *h;
+    size_t h_size;
+    char *error;
+} BulkLine;
+
+typedef struct _BulkPool BulkPool;
+
+typedef struct {
+    BulkPool *pool;
+    pthread_mutex_t lock;
+    BulkLine **queue;
+    size_t head, tail; /* pending lines are queue[head;tail[ */
+    pthread_t tid;
+    bool started;
+} BulkWorker;
+
+struct _BulkPool {
+    int engine;
+    long threads;
+    BulkWorker *workers;
+};
+
+# define IS_DIGIT(c) \
+    ((c) >= '0' && (c) <= '9')
+
+static uint64_t bulk_cost(const char *expr, size_t len)
+{
+    size_t i;
+    uint64_t integers;
+
+    integers = 0;
+    for (i = 0; i < len; i++) {
+        if (IS_DIGIT(expr[i]) && (0 == i || !IS_DIGIT(expr[i - 1]))) {
+            ++integers;
+        }
+    }
+
+    /* integers is an upper bound of the number of symbols, the exponent of the cost */
+    return (MIN(integers, UINT32_MAX) << 32) | MIN(len, UINT32_MAX);
+}
+
+static int bulk_line_cmp(const void *a, const void *b)
+{
+    const BulkLine *la, *lb;
+
+    la = *((const BulkLine * const *) a);
+    lb = *((const BulkLine * const *) b);
+    if (la->cost != lb->cost) {
+        return la->cost < lb->cost ? 1 : -1;
+    }
+
+    return la < lb ? -1 : la > lb;
+}
+
+static BulkLine *bulk_take(BulkWorker *worker, bool steal)
+{
+    BulkLine *line;
+
+    line = NULL;
+    pthread_mutex_lock(&worker->lock);
+    if (worker->head < worker->tail) {
+        if (steal) {
+            line = worker->queue[--worker->tail];
+        } else {
+            line = worker->queue[worker->head++];
+        }
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    return line;
+}
+
+static void *bulk_worker(void *arg)
+{
+    Arena *arena;
+    BulkPool *pool;
+    BulkWorker *this;
+
+    this = (BulkWorker *) arg;
+    pool = this->pool;
+    arena = arena_new(0);
+    for (;;) {
+        long i;
+        BulkLine *line;
+        uint8_t all_true, all_false;
+
+        line = bulk_take(this, FALSE);
+        /* no line is added during a batch: when all queues are empty, we are done */
+        for (i = 1; NULL == line && i < pool->threads; i++) {
+            line = bulk_take(&pool->workers[(this - pool->workers + i) % pool->threads], TRUE);
+        }
+        if (NULL == line) {
+            break;
+        }
+        if (NULL == (line->h = compile_expression(arena, pool->engine, line->expr, line->expr + line->len, &line->h_size, &all_true, &all_false))) {
+            line->error = strdup(error_message);
+        }
+        arena_reset(arena);
+    }
+    arena_destroy(arena);
+
+    return NULL;
+}
+
+static int compile_bulk(int fd, size_t size, int engine, long threads)
+{
+    int ret;
+    long w;
+    BulkPool pool;
+    BulkLine *lines, **order;
+    const char *map, *p, *end;
+
+    if (0 == size) {
+        return EXIT_SUCCESS;
+    }
+    if (MAP_FAILED == (map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0))) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    madvise((void *) map, size, MADV_SEQUENTIAL);
+    ret = EXIT_SUCCESS;
+    pool.engine = engine;
+    pool.threads = threads;
+    pool.workers = mem_new_n(*pool.workers, threads);
+    for (w = 0; w < threads; w++) {
+        pool.workers[w].pool = &pool;
+        pool.workers[w].queue = mem_new_n(*pool.workers[w].queue, BULK_BATCH_LINES / threads + 1);
+        pthread_mutex_init(&pool.workers[w].lock, NULL);
+    }
+    lines = mem_new_n(*lines, BULK_BATCH_LINES);
+    order = mem_new_n(*order, BULK_BATCH_LINES);
+    for (p = map, end = map + size; p < end; /* NOP */) {
+        size_t i, n;
+
+        for (n = 0; p < end && n < BULK_BATCH_LINES; n++) {
+            const char *eol;
+
+            if (NULL == (eol = memchr(p, '\n', end - p))) {
+                eol = end;
+            }
+            lines[n].expr = p;
+            lines[n].len = eol - p;
+            if (lines[n].len > 0 && '\r' == p[lines[n].len - 1]) {
+                --lines[n].len;
+            }
+            lines[n].cost = bulk_cost(lines[n].expr, lines[n].len);
+            lines[n].h = NULL;
+            lines[n].error = NULL;
+            order[n] = &lines[n];
+            p = eol < end ? eol + 1 : end;
+        }
+        qsort(order, n, sizeof(*order), bulk_line_cmp);
+        pool.threads = MIN(threads, (long) n);
+        for (w = 0; w < pool.threads; w++) {
+            pool.workers[w].head = pool.workers[w].tail = 0;
+        }
+        for (i = 0; i < n; i++) {
+            BulkWorker *worker;
+
+            worker = &pool.workers[i % pool.threads];
+            worker->queue[worker->tail++] = order[i];
+        }
+        for (w = 1; w < pool.threads; w++) {
+            pool.workers[w].started = 0 == pthread_create(&pool.workers[w].tid, NULL, bulk_worker, &pool.workers[w]);
+        }
+        /* the first worker is the current thread, the lines of the others are stolen if they failed to start */
+        bulk_worker(&pool.workers[0]);
+        for (w = 1; w < pool.threads; w++) {
+            if (pool.workers[w].started) {
+                pthread_join(pool.workers[w].tid, NULL);
+            }
+        }
+        for (i = 0; i < n; i++) {
+            if (NULL == lines[i].h) {
+                ret = EXIT_FAILURE;
+            }
+            print_result(lines[i].expr, lines[i].len, lines[i].h, lines[i].h_size, NULL == lines[i].error ? "out of memory" : lines[i].error);
+            if (NULL != lines[i].h) {
+                free(lines[i].h);
+            }
+            if (NULL != lines[i].error) {
+                free(lines[i].error);
+            }
+        }
+    }
+    for (w = 0; w < threads; w++) {
+        pthread_mutex_destroy(&pool.workers[w].lock);
+        free(pool.workers[w].queue);
+    }
+    free(pool.workers);
+    free(order);
+    free(lines);
+    munmap((void *) map, size);
+
+    return ret;
+}
+
+/**
+ * Compile the expressions of filename ("-" for stdin), one by line, in
+ * parallel if it is a regular file.
+ **/
+static int compile_file(const char *filename, int engine)
+{
+    int fd, ret;
+    struct stat st;
+
+    if (0 == strcmp(filename, "-")) {
+        return compile_stream(stdin, engine);
+    }
+    if (-1 == (fd = open(filename, O_RDONLY))) {
+        perror(filename);
+        return EXIT_FAILURE;
+    }
+    if (0 == fstat(fd, &st) && S_ISREG(st.st_mode)) {
+        long threads;
+
+        /* parallelize between expressions, not inside a table */
+        threads = table_threads;
+        table_threads = 1;
+        ret = compile_bulk(fd, st.st_size, engine, threads);
+        close(fd);
+    } else {
+        FILE *fp;
+
+        if (NULL == (fp = fdopen(fd, "r"))) {
+            perror(filename);
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        ret = compile_stream(fp, engine);
+        fclose(fp);
+    }
+
+    return ret;
+}
+
+/**
+ * Parse the sets of integers of -m (separated by colons, their integers
+ * by commas) in CSR form: set i is [values + offsets[i];values + offsets[i + 1][.
+ * values and offsets have to be allocated by the caller with as many
+ * elements as separators plus one (plus two for offsets).
+ * Returns the number of sets or -1 if they are invalid.
+ **/
+static long parse_match_sets(const char *str, int32_t *values, size_t *offsets)
+{
+    long sets;
+    size_t count;
+    char *endptr;
+    long long value;
+
+    sets = 0;
+    count = 0;
+    offsets[0] = 0;
+    for (;;) {
+        /* an empty set is allowed */
+        if (':' != *str && '\0' != *str) {
+            for (;;) {
+                value = strtoll(str, &endptr, 10);
+                if (endptr == str || value < INT32_MIN || value > INT32_MAX) {
+                    return -1;
+                }
+                values[count++] = (int32_t) value;
+                str = endptr;
+                if (',' != *str) {
+                    break;
+                }
+                ++str;
+            }
+        }
+        offsets[++sets] = count;
+        if ('\0' == *str) {
+            break;
+        }
+        if (':' != *str) {
+            return -1;
+        }
+        ++str;
+    }
+
+    return sets;
+}
+
+# define CLI_CACHE_SIZE (16 * 1024 * 1024)
+
+/**
+ * compile_expression through a cache keyed, as in PostgreSQL, by the
+ * engine and the normalized expression (see normalize_expression) for -c
+ **/
+static uint8_t *compile_cached(Cache *cache, Arena *arena, int engine, const char *expr, const char * const end, size_t *h_size, uint8_t *all_true, uint8_t *all_false)
+{
+    char *key;
+    uint8_t *h;
+    size_t key_len;
+    CachedResult cached;
+
+    key = mem_new_n(*key, 1 + (end - expr));
+    key[0] = (char) engine;
+    key_len = 1 + normalize_expression(expr, end - expr, key + 1);
+    if (cache_lookup(cache, key, key_len, &cached)) {
+        /* like allocate_buffer, with a trailing NUL */
+        *h_size = cached.size + 1;
+        h = mem_new_n(*h, *h_size);
+        memcpy(h, cached.data, cached.size);
+        h[cached.size] = '\0';
+        *all_true = cached.all_true;
+        *all_false = cached.all_false;
+    } else if (NULL != (h = compile_expression(arena, engine, expr, end, h_size, all_true, all_false))) {
+        cached.data = h;
+        cached.size = *h_size - 1;
+        cached.all_true = *all_true;
+        cached.all_false = *all_false;
+        cache_insert(cache, key, key_len, &cached, CLI_CACHE_SIZE);
+    }
+    free(key);
+
+    return h;
+}
+
 int main(int argc, char **argv)
 {
     uint8_t **h;
-    int a, i, ret;
+    Cache *cache;
+    Arena *arena;
     size_t *h_size;
-    ParseResult result;
+    const char *filename;
+    int a, c, i, ret, engine;
+    int32_t *match_values;
+    size_t *match_offsets;
+    uint8_t *match_result;
+    long match_count;
     uint8_t all_true, all_false;
 
-    if (argc < 2) {
+    cache = NULL;
+    filename = NULL;
+    engine = ENGINE_TABLE;
+    match_values = NULL;
+    match_offsets = NULL;
+    match_result = NULL;
+    match_count = 0;
+# ifdef _SC_NPROCESSORS_ONLN
+    table_threads = MAX(1, sysconf(_SC_NPROCESSORS_ONLN));
+# endif /* _SC_NPROCESSORS_ONLN */
+    while (-1 != (c = getopt(argc, argv, "ce:f:gj:m:"))) {
+        switch (c) {
+            case 'c':
+                if (NULL == cache) {
+                    cache = cache_new();
+                }
+                break;
+            case 'e':
+                if (0 == strcmp(optarg, "table")) {
+                    engine = ENGINE_TABLE;
+                } else if (0 == strcmp(optarg, "bdd")) {
+                    engine = ENGINE_BDD;
+                } else if (0 == strcmp(optarg, "digest")) {
+                    engine = ENGINE_DIGEST;
+                } else {
+                    usage();
+                }
+                break;
+            case 'f':
+                filename = optarg;
+                break;
+            case 'g':
+                grouping = TRUE;
+                break;
+            case 'j':
+            {
+                char *endptr;
+
+                table_threads = strtol(optarg, &endptr, 10);
+                if ('\0' != *endptr || table_threads < 1) {
+                    usage();
+                }
+                break;
+            }
+            case 'm':
+            {
+                const char *p;
+                size_t separators;
+
+                for (p = optarg, separators = 0; '\0' != *p; p++) {
+                    separators += ',' == *p || ':' == *p;
+                }
+                free(match_values);
+                free(match_offsets);
+                free(match_result);
+                match_values = mem_new_n(*match_values, separators + 1);
+                match_offsets = mem_new_n(*match_offsets, separators + 2);
+                if (-1 == (match_count = parse_match_sets(optarg, match_values, match_offsets))) {
+                    usage();
+                }
+                match_result = mem_new_n(*match_result, BYTE_LENGTH(match_count));
+                break;
+            }
+            default:
+                usage();
+                break;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (NULL != match_values && ENGINE_TABLE != engine) {
+        usage();
+    }
+    if (NULL != filename) {
+        if (argc > 0 || NULL != match_values || NULL != cache) {
+            usage();
+        }
+        verbose = FALSE;
+        quiet = TRUE;
+        setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+        compile_start_states();
+        ret = compile_file(filename, engine);
+        if (grouping) {
+            group_print();
+        }
+        fflush(stdout);
+
+        return ret;
+    }
+    if (argc < 1) {
         usage();
     }
-    --argc;
-    ++argv;
     ret = EXIT_SUCCESS;
     compile_start_states();
+    arena = arena_new(0);
     h = mem_new_n(*h, argc);
     h_size = mem_new_n(*h_size, argc);
-    for (a = 0; a < argc && EXIT_SUCCESS == ret; a++) {
-        h[a] = NULL;
-    }
     for (a = 0; a < argc; a++) {
         const char * const end = argv[a] + strlen(argv[a]);
 
-        printf("EXPR = %.*s\n", end - argv[a], argv[a]);
+        printf("EXPR = %.*s\n", I(end - argv[a]), argv[a]);
         printf("=========\n");
-        if (!parse(argv[a], end, &result)) {
-            ret = EXIT_FAILURE;
-            goto end;
+        if (NULL != cache) {
+            h[a] = compile_cached(cache, arena, engine, argv[a], end, &h_size[a], &all_true, &all_false);
+        } else {
+            h[a] = compile_expression(arena, engine, argv[a], end, &h_size[a], &all_true, &all_false);
         }
-        if (hashtable_size(result.symbols) > (sizeof(uint32_t) * CHAR_BIT - 1)) {
-            fprintf(stderr, "too many symbols, max is %ld\n", sizeof(uint32_t) * CHAR_BIT - 1);
+        if (NULL == h[a]) {
             ret = EXIT_FAILURE;
-            goto end;
-        }
-        printf("=========\n");
-        print_tree(result.root);
-        printf("=========\n");
-        h[a] = compute_hash(&h_size[a], &result, &all_true, &all_false);
-        printf("H = ");
-        for (i = 0; i < h_size[a]; i++) {
-            printf("%02X", h[a][i]);
-        }
-        printf("\n");
-        if (all_true) {
-            fprintf(stderr, "WARNING: expression '%s' is known to be (always) true\n", argv[a]);
-        }
-        if (all_false) {
-            fprintf(stderr, "WARNING: expression '%s' is known to be (always) false\n", argv[a]);
-        }
-end:
-        hashtable_destroy(result.symbols);
-        if (NULL != result.root) {
-            free_tree(result.root);
+        } else {
+            printf("H = ");
+            for (i = 0; i < h_size[a]; i++) {
+                printf("%02X", h[a][i]);
+            }
+            printf("\n");
+            if (NULL != match_values) {
+                CompiledQuery query;
+
+                /* h_size counts the trailing NUL of allocate_buffer */
+                if (compiled_query_init(&query, h[a], h_size[a] - 1)) {
+                    compiled_query_match_batch(&query, match_values, match_offsets, match_count, match_result);
+                    for (i = 0; i < match_count; i++) {
+                        printf("M = %s\n", GETBIT_AT(match_result[BITSLOT(i)], i % CHAR_BIT) ? "true" : "false");
+                    }
+                }
+            }
+            if (all_true) {
+                fprintf(stderr, "WARNING: expression '%s' is known to be (always) true\n", argv[a]);
+            }
+            if (all_false) {
+                fprintf(stderr, "WARNING: expression '%s' is known to be (always) false\n", argv[a]);
+            }
         }
+        arena_reset(arena);
     }
+    arena_destroy(arena);
 
     printf("=========\n");
-    for (a = 0; a < argc; a++) {
+    if (grouping) {
+        for (a = 0; a < argc; a++) {
+            if (NULL != h[a]) {
+                group_add(argv[a], strlen(argv[a]), h[a], h_size[a]);
+            }
+        }
+        group_print();
+    }
+    for (a = 0; a < argc && !grouping; a++) {
         for (i = a + 1; i < argc; i++) {
+            if (NULL == h[a] || NULL == h[i]) {
+                continue;
+            }
             printf("%s %c= %s\n", argv[a], 0 == strcmp_l(h[a], h_size[a], h[i], h_size[i]) ? '=' : '!', argv[i]);
         }
     }
@@ -842,10 +3482,17 @@ end:
             free(h[a]);
         }
     }
+    if (NULL != cache) {
+        cache_destroy(cache);
+    }
+    free(match_result);
+    free(match_offsets);
+    free(match_values);
     free(h_size);
     free(h);
 
     return ret;
 }
 
+# endif /* !BENCHMARK */
 #endif /* POSTGRESQL */
@@ -0,0 +1,68 @@
+#include "program.h"
+
+#define PROGRAM_MIN_SIZE 32
+
+void program_init(Program *this)
+{
+    this->code = NULL;
+    this->length = this->allocated = 0;
+    this->depth = this->max_depth = 0;
+    this->temporaries = 0;
+}
+
+void program_emit(Program *this, Opcode opcode, uint32_t operand)
+{
+    assert(operand <= OPERAND_MAX);
+
+    if (this->length >= this->allocated) {
+        if (NULL == this->code) {
+            this->allocated = PROGRAM_MIN_SIZE;
+            this->code = mem_new_n(*this->code, this->allocated);
+        } else {
+            this->allocated <<= 1;
+            this->code = mem_renew(this->code, *this->code, this->allocated);
+        }
+    }
+    this->code[this->length++] = INSTRUCTION(opcode, operand);
+    switch (opcode) {
+        case OP_PUSH:
+        case OP_LOAD:
+            if (++this->depth > this->max_depth) {
+                this->max_depth = this->depth;
+            }
+            break;
+        case OP_AND:
+        case OP_OR:
+        case OP_XOR:
+            assert(this->depth >= 2);
+            --this->depth;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Replace the operand of each OP_PUSH by its value in map (ie change
+ * the symbol identifiers given at parse time into their bit number)
+ **/
+void program_remap(Program *this, const uint32_t *map)
+{
+    size_t i;
+
+    for (i = 0; i < this->length; i++) {
+        if (OP_PUSH == OPCODE(this->code[i])) {
+            this->code[i] = INSTRUCTION(OP_PUSH, map[OPERAND(this->code[i])]);
+        }
+    }
+}
+
+void program_free(Program *this)
+{
+#ifndef NO_NEED_TO_FREE
+    if (NULL != this->code) {
+        free(this->code);
+    }
+#endif /* !NO_NEED_TO_FREE */
+    program_init(this);
+}
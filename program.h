@@ -0,0 +1,61 @@
+#ifndef PROGRAM_H
+
+# define PROGRAM_H
+
+# include "common.h"
+
+/**
+ * A query_int compiled as a postfix program: each instruction is an
+ * opcode (the 4 lowest bits) followed, for OP_PUSH, by its operand
+ * (the symbol). The program is run on a value stack of at most
+ * max_depth elements and ends with OP_END.
+ * A value needed several times (a shared subexpression, see simplify.h)
+ * can be computed once, kept by OP_STORE in a slot of the frame and
+ * pushed again by OP_LOAD: the operand of both is the index of the slot
+ * from the bottom of the stack, the temporaries following the max_depth
+ * slots of the stack. Such a program is run on a frame of
+ * max_depth + temporaries values.
+ **/
+
+typedef enum {
+    OP_END = 0, // end of program (or, in nodes.h, node which doesn't generate any instruction)
+    OP_PUSH,    // push value of symbol OPERAND
+    OP_NOT,
+    OP_AND,
+    OP_OR,
+    OP_XOR,
+    OP_LOAD,    // push value of slot OPERAND
+    OP_STORE,   // copy the value on the top of the stack in slot OPERAND
+    _OP_COUNT
+} Opcode;
+
+typedef uint32_t Instruction;
+
+# define OPCODE_BITS 4
+# define OPCODE_MASK ((1U << OPCODE_BITS) - 1)
+# define OPERAND_MAX (UINT32_MAX >> OPCODE_BITS)
+
+# define INSTRUCTION(opcode, operand) \
+    ((Instruction) (((operand) << OPCODE_BITS) | (opcode)))
+
+# define OPCODE(instruction) \
+    ((Opcode) ((instruction) & OPCODE_MASK))
+
+# define OPERAND(instruction) \
+    ((instruction) >> OPCODE_BITS)
+
+typedef struct {
+    Instruction *code;
+    size_t length;
+    size_t allocated;
+    size_t depth;
+    size_t max_depth;
+    size_t temporaries;
+} Program;
+
+void program_init(Program *);
+void program_emit(Program *, Opcode, uint32_t);
+void program_remap(Program *, const uint32_t *);
+void program_free(Program *);
+
+#endif /* !PROGRAM_H */
@@ -0,0 +1,125 @@
+#include <string.h>
+
+#include "sha256.h"
+
+static const uint32_t k[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+#define ROTR(x, n) \
+    (((x) >> (n)) | ((x) << (32 - (n))))
+
+void sha256_init(SHA256Context *ctx)
+{
+    ctx->state[0] = 0x6A09E667;
+    ctx->state[1] = 0xBB67AE85;
+    ctx->state[2] = 0x3C6EF372;
+    ctx->state[3] = 0xA54FF53A;
+    ctx->state[4] = 0x510E527F;
+    ctx->state[5] = 0x9B05688C;
+    ctx->state[6] = 0x1F83D9AB;
+    ctx->state[7] = 0x5BE0CD19;
+    ctx->length = 0;
+    ctx->buffered = 0;
+}
+
+static void sha256_transform(SHA256Context *ctx, const uint8_t *block)
+{
+    int i;
+    uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = ((uint32_t) block[4 * i] << 24) | ((uint32_t) block[4 * i + 1] << 16) | ((uint32_t) block[4 * i + 2] << 8) | block[4 * i + 3];
+    }
+    for (i = 16; i < 64; i++) {
+        w[i] = (ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10)) + w[i - 7]
+            + (ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3)) + w[i - 16];
+    }
+    a = ctx->state[0];
+    b = ctx->state[1];
+    c = ctx->state[2];
+    d = ctx->state[3];
+    e = ctx->state[4];
+    f = ctx->state[5];
+    g = ctx->state[6];
+    h = ctx->state[7];
+    for (i = 0; i < 64; i++) {
+        t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+        t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+void sha256_update(SHA256Context *ctx, const void *data, size_t len)
+{
+    const uint8_t *p;
+
+    p = (const uint8_t *) data;
+    ctx->length += len;
+    if (ctx->buffered > 0) {
+        size_t n;
+
+        n = MIN(len, SHA256_BLOCK_LENGTH - ctx->buffered);
+        memcpy(ctx->buffer + ctx->buffered, p, n);
+        ctx->buffered += n;
+        p += n;
+        len -= n;
+        if (ctx->buffered < SHA256_BLOCK_LENGTH) {
+            return;
+        }
+        sha256_transform(ctx, ctx->buffer);
+        ctx->buffered = 0;
+    }
+    for (/* NOP */; len >= SHA256_BLOCK_LENGTH; p += SHA256_BLOCK_LENGTH, len -= SHA256_BLOCK_LENGTH) {
+        sha256_transform(ctx, p);
+    }
+    memcpy(ctx->buffer, p, len);
+    ctx->buffered = len;
+}
+
+void sha256_final(SHA256Context *ctx, uint8_t digest[SHA256_DIGEST_LENGTH])
+{
+    int i;
+    uint64_t bits;
+
+    bits = ctx->length * CHAR_BIT;
+    ctx->buffer[ctx->buffered++] = 0x80;
+    if (ctx->buffered > SHA256_BLOCK_LENGTH - sizeof(bits)) {
+        memset(ctx->buffer + ctx->buffered, 0, SHA256_BLOCK_LENGTH - ctx->buffered);
+        sha256_transform(ctx, ctx->buffer);
+        ctx->buffered = 0;
+    }
+    memset(ctx->buffer + ctx->buffered, 0, SHA256_BLOCK_LENGTH - sizeof(bits) - ctx->buffered);
+    for (i = 0; i < 8; i++) {
+        ctx->buffer[SHA256_BLOCK_LENGTH - 1 - i] = (uint8_t) (bits >> (8 * i));
+    }
+    sha256_transform(ctx, ctx->buffer);
+    for (i = 0; i < 8; i++) {
+        digest[4 * i] = (uint8_t) (ctx->state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t) (ctx->state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t) (ctx->state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t) ctx->state[i];
+    }
+}
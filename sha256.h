@@ -0,0 +1,26 @@
+#ifndef SHA256_H
+
+# define SHA256_H
+
+# include "common.h"
+
+/**
+ * SHA-256 (FIPS 180-4), computed incrementally: data can be given in as
+ * many sha256_update calls as needed.
+ **/
+
+# define SHA256_BLOCK_LENGTH 64
+# define SHA256_DIGEST_LENGTH 32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length; /* in bytes */
+    uint8_t buffer[SHA256_BLOCK_LENGTH];
+    size_t buffered;
+} SHA256Context;
+
+void sha256_init(SHA256Context *);
+void sha256_update(SHA256Context *, const void *, size_t);
+void sha256_final(SHA256Context *, uint8_t [SHA256_DIGEST_LENGTH]);
+
+#endif /* !SHA256_H */
@@ -0,0 +1,498 @@
+#include <string.h>
+
+#include "simplify.h"
+
+#define SIMPLIFY_MIN_OPERANDS 8
+#define SIMPLIFY_NO_SLOT UINT32_MAX
+
+typedef struct _Term Term;
+
+struct _Term {
+    uint32_t id; /* in order of creation */
+    Opcode op; /* OP_END for the constants */
+    uint32_t symbol; /* operand of OP_PUSH, value of a constant */
+    uint32_t hash;
+    uint32_t need; /* depth of the stack to evaluate it */
+    uint32_t count;
+    Term **operands; /* by ascending id */
+    Term **order; /* operands by descending need, order of evaluation */
+    uint32_t refs; /* operands of the terms reachable from the root which are this one */
+    uint32_t slot; /* temporary keeping its value once evaluated, if shared */
+};
+
+/**
+ * A value of the stack: a term or, while a chain of the same operator
+ * is read, its operands (the term is then NULL)
+ **/
+typedef struct {
+    Term *term;
+    Opcode op;
+    Term **operands;
+    uint32_t count;
+    uint32_t allocated;
+} SimplifyValue;
+
+typedef struct {
+    Term *term;
+    uint32_t next; /* operand */
+} SimplifyFrame;
+
+typedef struct {
+    Arena *arena;
+    Term constants[2];
+    uint32_t count;
+    /* unique table (open addressing, NULL marks an empty slot) */
+    Term **unique;
+    size_t unique_mask;
+} Simplifier;
+
+static inline uint32_t simplify_mix(uint32_t h, uint32_t v)
+{
+    return h ^ (v + UINT32_C(0x9E3779B9) + (h << 6) + (h >> 2));
+}
+
+static int term_id_cmp(const void *a, const void *b)
+{
+    const Term *ta, *tb;
+
+    ta = *((const Term **) a);
+    tb = *((const Term **) b);
+
+    return (ta->id > tb->id) - (ta->id < tb->id);
+}
+
+static int term_need_cmp(const void *a, const void *b)
+{
+    const Term *ta, *tb;
+
+    ta = *((const Term **) a);
+    tb = *((const Term **) b);
+    if (ta->need != tb->need) {
+        return ta->need < tb->need ? 1 : -1;
+    }
+
+    return (ta->id > tb->id) - (ta->id < tb->id);
+}
+
+/**
+ * Most chains are short: insertion sort under SIMPLIFY_MIN_OPERANDS
+ * operands, qsort above
+ **/
+static void term_sort(Term **terms, uint32_t count, int (*cmp)(const void *, const void *))
+{
+    uint32_t i, j;
+    Term *t;
+
+    if (count > SIMPLIFY_MIN_OPERANDS) {
+        qsort(terms, count, sizeof(*terms), cmp);
+        return;
+    }
+    for (i = 1; i < count; i++) {
+        t = terms[i];
+        for (j = i; j > 0 && cmp(&terms[j - 1], &t) > 0; j--) {
+            terms[j] = terms[j - 1];
+        }
+        terms[j] = t;
+    }
+}
+
+/**
+ * Is t one of the operands (sorted by id)?
+ **/
+static bool term_find(Term * const *operands, uint32_t count, const Term *t)
+{
+    uint32_t lo, hi, mid;
+
+    lo = 0;
+    hi = count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (operands[mid] == t) {
+            return TRUE;
+        } else if (operands[mid]->id < t->id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * The only term of its operator, symbol and operands (which are copied)
+ **/
+static Term *term_intern(Simplifier *this, Opcode op, uint32_t symbol, Term **operands, uint32_t count)
+{
+    size_t i;
+    uint32_t h, o;
+    Term *t;
+
+    h = simplify_mix(op, symbol);
+    for (o = 0; o < count; o++) {
+        h = simplify_mix(h, operands[o]->id);
+    }
+    h ^= h >> 15;
+    h *= UINT32_C(0x2C1B3C6D);
+    h ^= h >> 12;
+    for (i = h & this->unique_mask; NULL != (t = this->unique[i]); i = (i + 1) & this->unique_mask) {
+        if (t->hash == h && t->op == op && t->symbol == symbol && t->count == count && (0 == count || 0 == memcmp(t->operands, operands, count * sizeof(*operands)))) {
+            return t;
+        }
+    }
+    /* the term then its operands, in both orders */
+    t = arena_alloc(this->arena, sizeof(*t) + 2 * count * sizeof(*operands));
+    t->id = this->count++;
+    t->op = op;
+    t->symbol = symbol;
+    t->hash = h;
+    t->count = count;
+    t->operands = t->order = NULL;
+    t->need = 1;
+    t->refs = 0;
+    t->slot = SIMPLIFY_NO_SLOT;
+    if (0 != count) {
+        t->operands = (Term **) (t + 1);
+        memcpy(t->operands, operands, count * sizeof(*operands));
+        t->order = t->operands + count;
+        memcpy(t->order, operands, count * sizeof(*operands));
+        /* the deepest operands first: each one evaluated then stays on the stack */
+        term_sort(t->order, count, term_need_cmp);
+        for (o = 0; o < count; o++) {
+            t->need = MAX(t->need, t->order[o]->need + o);
+        }
+    }
+    this->unique[i] = t;
+
+    return t;
+}
+
+static Term *term_not(Simplifier *this, Term *t)
+{
+    if (OP_END == t->op) { /* !0 = 1 */
+        return &this->constants[!t->symbol];
+    }
+    if (OP_NOT == t->op) { /* !!x = x */
+        return t->operands[0];
+    }
+
+    return term_intern(this, OP_NOT, 0, &t, 1);
+}
+
+static Term *term_xor(Simplifier *this, Term *a, Term *b)
+{
+    Term *operands[2];
+
+    if (a == b) { /* x ^ x = 0 */
+        return &this->constants[FALSE];
+    }
+    if (OP_END == b->op) {
+        Term *t;
+
+        t = a;
+        a = b;
+        b = t;
+    }
+    if (OP_END == a->op) { /* x ^ 0 = x, x ^ 1 = !x */
+        return a->symbol ? term_not(this, b) : b;
+    }
+    if ((OP_NOT == a->op && a->operands[0] == b) || (OP_NOT == b->op && b->operands[0] == a)) { /* x ^ !x = 1 */
+        return &this->constants[TRUE];
+    }
+    if (OP_NOT == a->op && OP_NOT == b->op) { /* !x ^ !y = x ^ y */
+        return term_xor(this, a->operands[0], b->operands[0]);
+    }
+    operands[0] = a->id < b->id ? a : b;
+    operands[1] = a->id < b->id ? b : a;
+
+    return term_intern(this, OP_XOR, 0, operands, 2);
+}
+
+/**
+ * Term of the operands of a chain of OP_AND or OP_OR (none of them of
+ * the same operator), which are reordered
+ **/
+static Term *term_chain(Simplifier *this, Opcode op, Term **operands, uint32_t count)
+{
+    bool *absorbed;
+    uint32_t i, j, k;
+    Term *identity, *absorbing;
+
+    identity = &this->constants[OP_AND == op];
+    absorbing = &this->constants[OP_OR == op];
+    term_sort(operands, count, term_id_cmp);
+    for (i = j = 0; i < count; i++) {
+        if (absorbing == operands[i]) { /* x & 0 = 0 */
+            return absorbing;
+        }
+        /* x & 1 = x, x & x = x */
+        if (identity != operands[i] && (0 == j || operands[j - 1] != operands[i])) {
+            operands[j++] = operands[i];
+        }
+    }
+    count = j;
+    for (i = 0; i < count; i++) {
+        if (OP_NOT == operands[i]->op && term_find(operands, count, operands[i]->operands[0])) { /* x & !x = 0 */
+            return absorbing;
+        }
+    }
+    /* x & (x | y) = x (x, not being of the same operator as (x | y), is never absorbed itself) */
+    absorbed = NULL;
+    for (i = 0; i < count; i++) {
+        if ((OP_AND == op ? OP_OR : OP_AND) == operands[i]->op) {
+            for (k = 0; k < operands[i]->count; k++) {
+                if (term_find(operands, count, operands[i]->operands[k])) {
+                    if (NULL == absorbed) {
+                        absorbed = arena_mem_new_n(this->arena, *absorbed, count);
+                        memset(absorbed, 0, count * sizeof(*absorbed));
+                    }
+                    absorbed[i] = TRUE;
+                    break;
+                }
+            }
+        }
+    }
+    if (NULL != absorbed) {
+        for (i = j = 0; i < count; i++) {
+            if (!absorbed[i]) {
+                operands[j++] = operands[i];
+            }
+        }
+        count = j;
+    }
+    if (0 == count) {
+        return identity;
+    }
+    if (1 == count) {
+        return operands[0];
+    }
+
+    return term_intern(this, op, 0, operands, count);
+}
+
+static void value_append(Simplifier *this, SimplifyValue *v, Term **operands, uint32_t count)
+{
+    if (v->count + count > v->allocated) {
+        Term **old;
+
+        old = v->operands;
+        v->allocated = MAX(MAX(2 * v->allocated, v->count + count), SIMPLIFY_MIN_OPERANDS);
+        v->operands = arena_mem_new_n(this->arena, *v->operands, v->allocated);
+        if (0 != v->count) {
+            memcpy(v->operands, old, v->count * sizeof(*old));
+        }
+    }
+    memcpy(v->operands + v->count, operands, count * sizeof(*operands));
+    v->count += count;
+}
+
+/**
+ * Appends t to the chain v, or its operands if it is of the same operator
+ **/
+static void value_append_term(Simplifier *this, SimplifyValue *v, Term *t)
+{
+    if (t->op == v->op) {
+        value_append(this, v, t->operands, t->count);
+    } else {
+        value_append(this, v, &t, 1);
+    }
+}
+
+static Term *value_close(Simplifier *this, SimplifyValue *v)
+{
+    if (NULL == v->term) {
+        v->term = term_chain(this, v->op, v->operands, v->count);
+    }
+
+    return v->term;
+}
+
+/**
+ * left op right into left, by appending the operands of the smallest
+ * chain to the largest one
+ **/
+static void value_combine(Simplifier *this, SimplifyValue *left, SimplifyValue *right, Opcode op)
+{
+    bool left_chain, right_chain;
+
+    left_chain = NULL == left->term && op == left->op;
+    right_chain = NULL == right->term && op == right->op;
+    if (right_chain && (!left_chain || right->count > left->count)) {
+        SimplifyValue v;
+
+        v = *left;
+        *left = *right;
+        *right = v;
+        left_chain = TRUE;
+        right_chain = NULL == right->term && op == right->op;
+    }
+    if (!left_chain) {
+        Term *t;
+
+        t = value_close(this, left);
+        left->term = NULL;
+        left->op = op;
+        left->operands = NULL;
+        left->count = left->allocated = 0;
+        value_append_term(this, left, t);
+    }
+    if (right_chain) {
+        value_append(this, left, right->operands, right->count);
+    } else {
+        value_append_term(this, left, value_close(this, right));
+    }
+}
+
+/**
+ * Counts the references to the terms reachable from root
+ **/
+static void term_count_refs(Simplifier *this, Term *root)
+{
+    size_t sp;
+    uint32_t o;
+    Term *t, **stack;
+
+    /* each term is pushed once */
+    stack = arena_mem_new_n(this->arena, *stack, this->count);
+    sp = 0;
+    stack[sp++] = root;
+    root->refs = 1;
+    while (0 != sp) {
+        t = stack[--sp];
+        for (o = 0; o < t->count; o++) {
+            if (0 == t->operands[o]->refs++) {
+                stack[sp++] = t->operands[o];
+            }
+        }
+    }
+}
+
+/**
+ * A shared term is worth a temporary if it is more expensive to evaluate
+ * again than to load (a symbol or its negation are not)
+ **/
+static inline bool term_is_kept(const Term *t)
+{
+    return t->refs > 1 && OP_PUSH != t->op && !(OP_NOT == t->op && OP_PUSH == t->operands[0]->op);
+}
+
+/**
+ * Emits the program of root, where a shared term is evaluated once then
+ * kept in a temporary (its slot is numbered from 0 here) and loaded
+ **/
+static uint32_t term_emit(Simplifier *this, Term *root, Program *program)
+{
+    size_t sp;
+    uint32_t temporaries;
+    SimplifyFrame *frames, *f;
+
+    /* a path never goes twice through the same term */
+    frames = arena_mem_new_n(this->arena, *frames, this->count);
+    term_count_refs(this, root);
+    temporaries = 0;
+    sp = 0;
+    frames[sp].term = root;
+    frames[sp++].next = 0;
+    while (0 != sp) {
+        f = &frames[sp - 1];
+        if (SIMPLIFY_NO_SLOT != f->term->slot) {
+            program_emit(program, OP_LOAD, f->term->slot);
+            --sp;
+            continue;
+        }
+        if (OP_PUSH == f->term->op) {
+            program_emit(program, OP_PUSH, f->term->symbol);
+            --sp;
+            continue;
+        }
+        /* the operator of a chain after each operand but the first */
+        if (OP_NOT != f->term->op && f->next >= 2) {
+            program_emit(program, f->term->op, 0);
+        }
+        if (f->next < f->term->count) {
+            frames[sp].term = f->term->order[f->next++];
+            frames[sp++].next = 0;
+        } else {
+            if (OP_NOT == f->term->op) {
+                program_emit(program, OP_NOT, 0);
+            }
+            if (term_is_kept(f->term)) {
+                f->term->slot = temporaries++;
+                program_emit(program, OP_STORE, f->term->slot);
+            }
+            --sp;
+        }
+    }
+
+    return temporaries;
+}
+
+/**
+ * Replaces the program by its simplification.
+ * Returns 0 or 1 if it is always false or true (the program is then
+ * left as is), -1 otherwise.
+ **/
+int program_simplify(Program *program, Arena *arena)
+{
+    size_t sp;
+    Term *root;
+    Simplifier this;
+    const Instruction *pc;
+    SimplifyValue *values;
+
+    this.arena = arena;
+    this.count = 0;
+    for (sp = 0; sp < ARRAY_SIZE(this.constants); sp++) {
+        memset(&this.constants[sp], 0, sizeof(this.constants[sp]));
+        this.constants[sp].id = this.count++;
+        this.constants[sp].op = OP_END;
+        this.constants[sp].symbol = sp;
+        this.constants[sp].need = 1;
+        this.constants[sp].slot = SIMPLIFY_NO_SLOT;
+    }
+    /* each instruction creates at most a term: keep the load factor under 1/2 */
+    for (this.unique_mask = SIMPLIFY_MIN_OPERANDS - 1; this.unique_mask < 2 * program->length; this.unique_mask = 2 * this.unique_mask + 1)
+        ;
+    this.unique = arena_mem_new_n(arena, *this.unique, this.unique_mask + 1);
+    memset(this.unique, 0, (this.unique_mask + 1) * sizeof(*this.unique));
+    values = arena_mem_new_n(arena, *values, program->max_depth);
+    sp = 0;
+    for (pc = program->code; OP_END != OPCODE(*pc); pc++) {
+        switch (OPCODE(*pc)) {
+            case OP_PUSH:
+                values[sp++].term = term_intern(&this, OP_PUSH, OPERAND(*pc), NULL, 0);
+                break;
+            case OP_NOT:
+                values[sp - 1].term = term_not(&this, value_close(&this, &values[sp - 1]));
+                break;
+            case OP_AND:
+            case OP_OR:
+                --sp;
+                value_combine(&this, &values[sp - 1], &values[sp], OPCODE(*pc));
+                break;
+            case OP_XOR:
+                --sp;
+                values[sp - 1].term = term_xor(&this, value_close(&this, &values[sp - 1]), value_close(&this, &values[sp]));
+                break;
+            default:
+                assert(FALSE);
+                break;
+        }
+    }
+    assert(1 == sp);
+    root = value_close(&this, &values[0]);
+    if (OP_END == root->op) {
+        return root->symbol;
+    }
+    program->length = program->depth = program->max_depth = 0;
+    program->temporaries = term_emit(&this, root, program);
+    program_emit(program, OP_END, 0);
+    /* the temporaries follow the stack in the frame */
+    for (sp = 0; sp < program->length; sp++) {
+        if (OP_LOAD == OPCODE(program->code[sp]) || OP_STORE == OPCODE(program->code[sp])) {
+            program->code[sp] = INSTRUCTION(OPCODE(program->code[sp]), OPERAND(program->code[sp]) + program->max_depth);
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,22 @@
+#ifndef SIMPLIFY_H
+
+# define SIMPLIFY_H
+
+# include "common.h"
+# include "arena.h"
+# include "program.h"
+
+/**
+ * Algebraic simplification of a program: the expression is rebuilt
+ * bottom-up as terms where chains of OP_AND (or OP_OR) are flattened
+ * into a single n-ary term and equal subterms are the same term, then
+ * rewritten by double negation, idempotence, complement, absorption and
+ * constant folding, and emitted again, each n-ary term as a chain of
+ * binary instructions. The terms form a DAG: a subexpression written
+ * several times, like 1|2 in '(1|2)&3 | (1|2)&4', is evaluated once,
+ * kept in a temporary (OP_STORE) and then reused (OP_LOAD).
+ **/
+
+int program_simplify(Program *, Arena *);
+
+#endif /* !SIMPLIFY_H */
@@ -0,0 +1,154 @@
+#include <string.h>
+
+#include "symtab.h"
+
+#define SYMTAB_MIN_SIZE 16
+
+typedef struct {
+    uint32_t value;
+    uint32_t id;
+} SymbolEntry;
+
+struct _SymbolTable {
+    Arena *arena;
+    /* open addressing, slots hold id + 1 (0 for an empty slot) */
+    uint32_t *slots;
+    uint32_t mask;
+    /* symbols, by id */
+    SymbolEntry *entries;
+    size_t count;
+    size_t allocated;
+    /* filled by symtab_sort */
+    uint32_t *values;
+    uint32_t *ranks;
+};
+
+/* finalizer of murmur3: consecutive or multiple of a power of 2 integers are spread over the whole table */
+static inline uint32_t symtab_hash(uint32_t value)
+{
+    value ^= value >> 16;
+    value *= UINT32_C(0x85EBCA6B);
+    value ^= value >> 13;
+    value *= UINT32_C(0xC2B2AE35);
+    value ^= value >> 16;
+
+    return value;
+}
+
+SymbolTable *symtab_new(Arena *arena)
+{
+    SymbolTable *this;
+
+    this = arena_mem_new(arena, *this);
+    this->arena = arena;
+    this->mask = 2 * SYMTAB_MIN_SIZE - 1;
+    this->slots = arena_mem_new_n(arena, *this->slots, this->mask + 1);
+    memset(this->slots, 0, (this->mask + 1) * sizeof(*this->slots));
+    this->count = 0;
+    this->allocated = SYMTAB_MIN_SIZE;
+    this->entries = arena_mem_new_n(arena, *this->entries, this->allocated);
+    this->values = this->ranks = NULL;
+
+    return this;
+}
+
+static void symtab_grow(SymbolTable *this)
+{
+    size_t id;
+    uint32_t i;
+    SymbolEntry *entries;
+
+    this->allocated <<= 1;
+    entries = arena_mem_new_n(this->arena, *entries, this->allocated);
+    memcpy(entries, this->entries, this->count * sizeof(*entries));
+    this->entries = entries;
+    /* keep the load factor under 1/2 */
+    this->mask = 2 * this->allocated - 1;
+    this->slots = arena_mem_new_n(this->arena, *this->slots, this->mask + 1);
+    memset(this->slots, 0, (this->mask + 1) * sizeof(*this->slots));
+    for (id = 0; id < this->count; id++) {
+        for (i = symtab_hash(this->entries[id].value) & this->mask; 0 != this->slots[i]; i = (i + 1) & this->mask)
+            ;
+        this->slots[i] = id + 1;
+    }
+}
+
+/**
+ * Returns the identifier of value, adding it if it is new
+ **/
+uint32_t symtab_intern(SymbolTable *this, uint32_t value)
+{
+    uint32_t i, id;
+
+    assert(NULL == this->values);
+
+    for (i = symtab_hash(value) & this->mask; 0 != this->slots[i]; i = (i + 1) & this->mask) {
+        if (this->entries[this->slots[i] - 1].value == value) {
+            return this->slots[i] - 1;
+        }
+    }
+    id = this->count++;
+    this->entries[id].value = value;
+    this->entries[id].id = id;
+    this->slots[i] = id + 1;
+    if (this->count >= this->allocated) {
+        symtab_grow(this);
+    }
+
+    return id;
+}
+
+size_t symtab_size(SymbolTable *this)
+{
+    return this->count;
+}
+
+static int symbol_entry_cmp(const void *a, const void *b)
+{
+    const SymbolEntry *ea, *eb;
+
+    ea = (const SymbolEntry *) a;
+    eb = (const SymbolEntry *) b;
+
+    return (ea->value > eb->value) - (ea->value < eb->value);
+}
+
+void symtab_sort(SymbolTable *this)
+{
+    size_t k;
+    SymbolEntry *sorted;
+
+    if (NULL != this->values) {
+        return;
+    }
+    sorted = arena_mem_new_n(this->arena, *sorted, this->count);
+    memcpy(sorted, this->entries, this->count * sizeof(*sorted));
+    qsort(sorted, this->count, sizeof(*sorted), symbol_entry_cmp);
+    this->values = arena_mem_new_n(this->arena, *this->values, this->count);
+    this->ranks = arena_mem_new_n(this->arena, *this->ranks, this->count);
+    for (k = 0; k < this->count; k++) {
+        this->values[k] = sorted[k].value;
+        this->ranks[sorted[k].id] = k;
+    }
+}
+
+/**
+ * Symbols in ascending order (symtab_sort has to be called first)
+ **/
+const uint32_t *symtab_values(SymbolTable *this)
+{
+    assert(NULL != this->values);
+
+    return this->values;
+}
+
+/**
+ * Rank, in ascending order, of each symbol by identifier (symtab_sort
+ * has to be called first)
+ **/
+const uint32_t *symtab_ranks(SymbolTable *this)
+{
+    assert(NULL != this->ranks);
+
+    return this->ranks;
+}
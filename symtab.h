@@ -0,0 +1,24 @@
+#ifndef SYMTAB_H
+
+# define SYMTAB_H
+
+# include "common.h"
+# include "arena.h"
+
+/**
+ * Set of the integers (symbols) of a query_int: each distinct one gets an
+ * identifier, in order of appearance, when interned. Once all symbols are
+ * known, symtab_sort gives them their rank in ascending order (the order
+ * of the output).
+ **/
+
+typedef struct _SymbolTable SymbolTable;
+
+SymbolTable *symtab_new(Arena *);
+uint32_t symtab_intern(SymbolTable *, uint32_t);
+size_t symtab_size(SymbolTable *);
+void symtab_sort(SymbolTable *);
+const uint32_t *symtab_values(SymbolTable *);
+const uint32_t *symtab_ranks(SymbolTable *);
+
+#endif /* !SYMTAB_H */
@@ -0,0 +1,194 @@
+/**
+ * Template of a SIMD truth table kernel (interpreter of the program over
+ * vectors of words), included by parser.c once per instruction set with
+ * the following macros defined:
+ * - KERNEL_NAME: suffix of the generated functions
+ * - KERNEL_TARGET: instruction set to compile the kernel for (see GCC's target attribute)
+ * - KERNEL_LANES: number of 64 bits words (64 rows each) by vector
+ * - KERNEL_LANES_SHIFT: log2(KERNEL_LANES)
+ *
+ * Lane k of a vector holds the word w + k (the rows 64 * (w + k) to
+ * 64 * (w + k) + 63). The range of words is expected to be a multiple of
+ * KERNEL_LANES words (the kernel falls back on the scalar one when it is
+ * smaller than a vector).
+ **/
+
+# define KERNEL_CONCAT_(a, b) a ## _ ## b
+# define KERNEL_CONCAT(a, b) KERNEL_CONCAT_(a, b)
+# define KERNEL_VECTOR KERNEL_CONCAT(vword, KERNEL_NAME)
+# define KERNEL_EVAL   KERNEL_CONCAT(eval_node, KERNEL_NAME)
+# define KERNEL_FILL   KERNEL_CONCAT(fill_table, KERNEL_NAME)
+# define KERNEL_GRAY_EVAL KERNEL_CONCAT(gray_eval, KERNEL_NAME)
+# define KERNEL_GRAY   KERNEL_CONCAT(fill_table_gray, KERNEL_NAME)
+
+typedef uint64_t KERNEL_VECTOR __attribute__((vector_size(KERNEL_LANES * sizeof(uint64_t))));
+
+__attribute__((target(KERNEL_TARGET)))
+static KERNEL_VECTOR KERNEL_EVAL(const Instruction *pc, KERNEL_VECTOR *sp, KERNEL_VECTOR w)
+{
+    KERNEL_VECTOR *frame;
+    VM_DISPATCH_TABLE;
+
+    frame = sp;
+    for (;;) {
+        switch (OPCODE(*pc)) {
+            VM_CASE(OP_PUSH)
+            {
+                uint32_t s;
+
+                s = OPERAND(*pc);
+                if (s < WORD_ROWS_SHIFT) {
+                    *sp++ = w - w + symbol_patterns[s];
+                } else {
+                    *sp++ = -((w >> (s - WORD_ROWS_SHIFT)) & 1);
+                }
+                ++pc;
+                VM_NEXT();
+            }
+            VM_CASE(OP_NOT)
+                sp[-1] = ~sp[-1];
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_AND)
+                --sp;
+                sp[-1] &= *sp;
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_OR)
+                --sp;
+                sp[-1] |= *sp;
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_XOR)
+                --sp;
+                sp[-1] ^= *sp;
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_LOAD)
+                *sp++ = frame[OPERAND(*pc)];
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_STORE)
+                frame[OPERAND(*pc)] = sp[-1];
+                ++pc;
+                VM_NEXT();
+            VM_CASE(OP_END)
+            default:
+                return sp[-1];
+        }
+    }
+}
+
+__attribute__((target(KERNEL_TARGET)))
+static void KERNEL_FILL(const Instruction *code, void *stack, uint8_t *t, uint32_t first, uint32_t last, uint64_t mask, size_t word_len, uint8_t *all_true, uint8_t *all_false)
+{
+    uint32_t k, w;
+    KERNEL_VECTOR v, wv, and_acc, or_acc;
+
+    if (last - first < KERNEL_LANES) {
+        fill_table_scalar(code, stack, t, first, last, mask, word_len, all_true, all_false);
+        return;
+    }
+    for (k = 0; k < KERNEL_LANES; k++) {
+        wv[k] = first + k;
+        and_acc[k] = ~UINT64_C(0);
+        or_acc[k] = 0;
+    }
+    for (w = first; w < last; w += KERNEL_LANES, wv += KERNEL_LANES) {
+        v = KERNEL_EVAL(code, (KERNEL_VECTOR *) stack, wv);
+        and_acc &= v;
+        or_acc |= v;
+        /* the whole word is written at once: swap the nibbles of each byte then rely on little endianness */
+        v = ((v << 4) & UINT64_C(0xF0F0F0F0F0F0F0F0)) | ((v >> 4) & UINT64_C(0x0F0F0F0F0F0F0F0F));
+        memcpy(t + (size_t) (w - first) * word_len, &v, sizeof(v));
+    }
+    for (k = 0; k < KERNEL_LANES; k++) {
+        *all_true &= and_acc[k] == ~UINT64_C(0);
+        *all_false &= 0 == or_acc[k];
+    }
+}
+
+__attribute__((target(KERNEL_TARGET)))
+static inline KERNEL_VECTOR KERNEL_GRAY_EVAL(const GrayInstruction *instruction, const KERNEL_VECTOR *values, KERNEL_VECTOR w)
+{
+    switch (instruction->opcode) {
+        case OP_PUSH:
+            if (instruction->left < WORD_ROWS_SHIFT) {
+                return w - w + symbol_patterns[instruction->left];
+            } else {
+                return -((w >> (instruction->left - WORD_ROWS_SHIFT)) & 1);
+            }
+        case OP_NOT:
+            return ~values[instruction->left];
+        case OP_LOAD:
+        case OP_STORE:
+            return values[instruction->left];
+        case OP_AND:
+            return values[instruction->left] & values[instruction->right];
+        case OP_OR:
+            return values[instruction->left] | values[instruction->right];
+        case OP_XOR:
+        default:
+            return values[instruction->left] ^ values[instruction->right];
+    }
+}
+
+/**
+ * Gray code walk (see fill_table_gray_scalar) of the vectors of words:
+ * only the symbols which are the same for all the words of a vector
+ * (bits 6 + KERNEL_LANES_SHIFT and above of a row) are flipped
+ **/
+__attribute__((target(KERNEL_TARGET)))
+static void KERNEL_GRAY(const GrayPlan *plan, void *stack, uint8_t *t, uint32_t first, uint32_t last, uint64_t mask, size_t word_len, uint8_t *all_true, uint8_t *all_false)
+{
+    size_t i;
+    uint32_t k, b, base, size, step;
+    KERNEL_VECTOR v, wv, and_acc, or_acc, *values;
+
+    if (last - first < KERNEL_LANES) {
+        fill_table_gray_scalar(plan, stack, t, first, last, mask, word_len, all_true, all_false);
+        return;
+    }
+    values = (KERNEL_VECTOR *) stack;
+    for (k = 0; k < KERNEL_LANES; k++) {
+        and_acc[k] = ~UINT64_C(0);
+        or_acc[k] = 0;
+    }
+    /* base and size are in vectors */
+    for (base = first >> KERNEL_LANES_SHIFT; base < last >> KERNEL_LANES_SHIFT; base += size) {
+        for (size = 1; 0 == (base & size) && base + 2 * size <= last >> KERNEL_LANES_SHIFT; size *= 2)
+            ;
+        for (k = 0; k < KERNEL_LANES; k++) {
+            wv[k] = (base << KERNEL_LANES_SHIFT) + k;
+        }
+        for (i = 0; i < plan->length; i++) {
+            values[i] = KERNEL_GRAY_EVAL(&plan->code[i], values, wv);
+        }
+        for (step = 0; step < size; step++) {
+            if (0 != step) {
+                b = lowest_bit(step) + KERNEL_LANES_SHIFT;
+                wv ^= wv - wv + (UINT64_C(1) << b);
+                for (i = plan->offsets[b]; i < plan->offsets[b + 1]; i++) {
+                    values[plan->dependents[i]] = KERNEL_GRAY_EVAL(&plan->code[plan->dependents[i]], values, wv);
+                }
+            }
+            v = values[plan->length - 1];
+            and_acc &= v;
+            or_acc |= v;
+            v = ((v << 4) & UINT64_C(0xF0F0F0F0F0F0F0F0)) | ((v >> 4) & UINT64_C(0x0F0F0F0F0F0F0F0F));
+            memcpy(t + (size_t) (wv[0] - first) * word_len, &v, sizeof(v));
+        }
+    }
+    for (k = 0; k < KERNEL_LANES; k++) {
+        *all_true &= and_acc[k] == ~UINT64_C(0);
+        *all_false &= 0 == or_acc[k];
+    }
+}
+
+# undef KERNEL_GRAY
+# undef KERNEL_GRAY_EVAL
+# undef KERNEL_FILL
+# undef KERNEL_EVAL
+# undef KERNEL_VECTOR
+# undef KERNEL_CONCAT
+# undef KERNEL_CONCAT_
@@ -8,5 +8,24 @@ assertExitValue "18|9" "${TESTDIR}/query_int_parser '18|9'  2>/dev/null | grep -
 assertExitValue "9|18" "${TESTDIR}/query_int_parser '9|18'  2>/dev/null | grep -xq 'H = 000000020000000900000012E000'" $TRUE
 assertExitValue "45|53|21" "${TESTDIR}/query_int_parser '45|53|21' 2>/dev/null | grep -xq 'H = 00000003000000150000002D00000035EF00'" $TRUE
 assertExitValue "45|53|21" "${TESTDIR}/query_int_parser '123|28|456|7' 2>/dev/null | grep -xq 'H = 00000004000000070000001C0000007B000001C8EFFF00'" $TRUE
+assertExitValue "bdd 18|9" "${TESTDIR}/query_int_parser -e bdd '18|9' 2>/dev/null | grep -xq 'H = 000000020000000900000012000000020000000100000000000000010000000000000002000000010000000300'" $TRUE
+assertExitValue "bdd 9|18|(9&18)" "${TESTDIR}/query_int_parser -e bdd '9|18|(9&18)' 2>/dev/null | grep -xq 'H = 000000020000000900000012000000020000000100000000000000010000000000000002000000010000000300'" $TRUE
+assertExitValue "digest 18|9" "${TESTDIR}/query_int_parser -e digest '18|9' 2>/dev/null | grep -xq 'H = FB0285C401733A2BBF0845F47B4149B7C17CBF3D1526BE971DF1044D18DCCEDA00'" $TRUE
+assertExitValue "40 symbols contradiction" "${TESTDIR}/query_int_parser '1&2&3&4&5&6&7&8&9&10&11&12&13&14&15&16&17&18&19&20&21&22&23&24&25&26&27&28&29&30&31&32&33&34&35&36&37&38&39&40&!1' 2>/dev/null | grep -xq 'H = 000000000000'" $TRUE
+assertExitValue "stream" "printf '18|9\\n1&x\\n' | ${TESTDIR}/query_int_parser -f - 2>/dev/null | tr '\\t' ' ' | tr '\\n' ';' | grep -xq '18|9 000000020000000900000012E000;1&x ERROR: invalid character .x. at offset 2;'" $TRUE
+assertExitValue "grouping" "printf '1|2\\n3\\n2|1\\n' | ${TESTDIR}/query_int_parser -g -f - 2>/dev/null | tr '\\t' ' ' | tr '\\n' ';' | grep -xq '1 1|2;1 2|1;2 3;'" $TRUE
+assertExitValue "irrelevant symbol" "${TESTDIR}/query_int_parser '3|(3&7)' 2>/dev/null | grep -xq 'H = 00000001000000032000'" $TRUE
+assertExitValue "largest symbol" "${TESTDIR}/query_int_parser '4294967295' 2>/dev/null | grep -xq 'H = 00000001FFFFFFFF2000'" $TRUE
+assertExitValue "out of range symbol" "${TESTDIR}/query_int_parser '4294967296' 2>&1 | grep -xq 'invalid number at offset 0'" $TRUE
+assertExitValue "postfix operator" "${TESTDIR}/query_int_parser '3!' 2>&1 | grep -xq 'invalid expression, remaining element found at offset 1'" $TRUE
+assertExitValue "simplification" "${TESTDIR}/query_int_parser '!!1&(1|2|3|4|5|6|7|8|9|10|11|12)&(1|(1&13))' 2>/dev/null | grep -xq 'H = 00000001000000012000'" $TRUE
+assertExitValue "shared subexpression" "${TESTDIR}/query_int_parser -e digest '(1&2|3)&4|(1&2|3)&5|!(1&2|3)&6|7&8&9&10&11&12' 2>/dev/null | grep -xq 'H = 6169E0B5DC590DDAF6ACC2A8EDF425C25B0A0C2F41E679FD0A41E83310A0E36500'" $TRUE
+assertExitValue "match" "${TESTDIR}/query_int_parser -m 100,18,9 '9&!18|18&100' 2>/dev/null | grep -xq 'M = true'" $TRUE
+assertExitValue "no match" "${TESTDIR}/query_int_parser -m 18,9 '9&!18|18&100' 2>/dev/null | grep -xq 'M = false'" $TRUE
+assertExitValue "batch match" "${TESTDIR}/query_int_parser -m '9:18:100,18,9::-1' '9&!18|18&100|4294967295' 2>/dev/null | grep '^M = ' | tr '\\n' ';' | grep -xq 'M = true;M = false;M = true;M = false;M = false;'" $TRUE
+assertExitValue "cached 102 then 10 2" "${TESTDIR}/query_int_parser -c '102' '10 2' 2>&1 | grep -xq 'invalid expression, remaining element found at offset 3'" $TRUE
+assertExitValue "cached 102 then 1 02" "${TESTDIR}/query_int_parser -c '102' '1 02' 2>&1 | grep -xq \"invalid character '0' at offset 2\"" $TRUE
+assertExitValue "bdd 300000 symbols chain" "seq -s '&' 300000 -1 1 | ${TESTDIR}/query_int_parser -e bdd -f - 2>/dev/null | cut -f 2 | grep -q '^000493E0'" $TRUE
+assertExitValue "bdd too deep" "printf '(%s)|(!20000&%s)\\n' \$(seq -s '&' 20000 -1 1) \$(seq -s '&' 19999 -1 1) | ${TESTDIR}/query_int_parser -e bdd -f - 2>/dev/null | cut -f 2 | grep -xq 'ERROR: too many variables along a path of the BDD, max is 16384'" $TRUE
 
 exit $?